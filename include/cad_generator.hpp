@@ -1,6 +1,8 @@
 #pragma once
 
 #include "pdf_processor.hpp"
+#include "symbol_instancer.hpp"
+#include "output_sink.hpp"
 #include <string>
 
 class CADGenerator {
@@ -13,16 +15,59 @@ public:
         DWG
     };
 
+    struct Options {
+        unsigned writerThreads = 0;       // Entity formatting threads, 0 = one per hardware thread
+        size_t entitiesPerChunk = 16384;  // Entities formatted per work item
+        bool instanceSymbols = false;     // Write repeated shapes as BLOCK + INSERT
+        SymbolInstancer::Options symbolOptions;
+        OutputSink::Options output;       // Compression follows the file name by default
+    };
+
+    void setOptions(const Options& options);
+    const Options& getOptions() const;
+
     // New method that combines setting elements and generating CAD file
     bool generateCAD(const std::vector<PDFProcessor::VectorElement>& vectors,
                     const std::vector<std::string>& texts,
                     const std::string& outputPath);
 
+    // Same, as DXF into `sink`, which is finished at the end. Use
+    // OutputSink::toBuffer() to get the drawing in memory. Image elements
+    // still refer to files, which extraction wrote to disk. Image paths are
+    // written as they are, since there is no drawing location to make them
+    // relative to.
+    bool generateCAD(const std::vector<PDFProcessor::VectorElement>& vectors,
+                    const std::vector<std::string>& texts,
+                    OutputSink& sink);
+
     // Original methods kept for backward compatibility
     bool setVectorElements(const std::vector<PDFProcessor::VectorElement>& elements);
     bool setTextElements(const std::vector<std::string>& texts);
+    bool setImageElements(const std::vector<PDFProcessor::ImageElement>& images);
     bool generateCAD(const std::string& outputPath, Format format);
 
+    // Streamed DXF output for pipelined conversion. Each streamVectors() call
+    // formats its LINE entities right away into a scratch file next to the
+    // output; finishStream() writes the DXF around them, with the image
+    // elements set by then ahead of the lines and the text after. The scratch
+    // file is written uncompressed whatever Options::output asks for, so
+    // streaming needs disk room for the plain LINE section as well as the
+    // output. Entities come out in the same order as generateCAD(); handles
+    // differ when there are images, since the lines are numbered first.
+    // Symbol instancing needs every vector up front and is not applied to
+    // streamed output.
+    bool beginStream(const std::string& outputPath);
+    bool streamVectors(const std::vector<PDFProcessor::VectorElement>& vectors);
+    bool finishStream();
+    // Drops a started stream without writing the output
+    void cancelStream();
+
+    // Replaces the current elements with those of a document model file
+    // written by PDFProcessor::exportModel(). Pages outside
+    // [firstPage, firstPage + pageCount) are skipped without being decoded;
+    // a negative pageCount reads to the end.
+    bool importModel(const std::string& path, int firstPage = 0, int pageCount = -1);
+
 private:
     class Impl;
     std::unique_ptr<Impl> pimpl;
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+// Client side of the ConversionServer protocol (see conversion_server.hpp)
+struct ConversionRequest {
+    std::string inputPath;
+    bool uploadInput = false;  // Send the file contents instead of its path
+    std::string outputPath;    // Empty = receive the DXF in the reply
+    std::vector<std::pair<std::string, std::string>> options;
+};
+
+struct ConversionReply {
+    bool ok = false;
+    std::string error;
+    std::string output;  // DXF data when no output path was given
+};
+
+bool requestConversion(const std::string& socketPath,
+                       const ConversionRequest& request,
+                       ConversionReply& reply,
+                       const std::function<void(const std::string&)>& onStatus = {});
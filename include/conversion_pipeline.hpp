@@ -0,0 +1,56 @@
+#pragma once
+
+#include "pdf_processor.hpp"
+#include "cad_generator.hpp"
+#include "pipeline.hpp"
+#include <string>
+#include <vector>
+
+// PDF to DXF conversion with overlapping phases. Instead of rendering every
+// page, then vectorizing every page, then writing the drawing, pages flow
+// through three stages connected by bounded queues:
+//
+//   render     renders pages to grayscale and pulls their text
+//   vectorize  traces the rendered pages into LINE elements
+//   write      formats each page's lines into the DXF entity stream, in page order
+//
+// so page N+1 renders while page N is traced and page N-1 is written. Queues
+// hold at most `queueCapacity` pages each, and no page is rendered until it
+// is within a window of the next page to write, one slot per worker and
+// queue entry. That bounds memory to a few pages however long the document
+// is, even behind a slow page. Images are extracted on a side thread at the
+// same time.
+//
+// The drawing has the same entities, in the same order, as PDFProcessor +
+// CADGenerator::generateCAD() without symbol instancing, which needs every
+// vector up front; see CADGenerator::beginStream() for the handles and the
+// uncompressed scratch file.
+class ConversionPipeline {
+public:
+    struct Options {
+        unsigned renderWorkers = 2;     // Each opens its own copy of the document
+        unsigned vectorizeWorkers = 0;  // 0 = one per hardware thread
+        size_t queueCapacity = 2;       // Pages waiting between two stages
+    };
+
+    // Takes extraction settings from `processor` and output settings from
+    // `generator`. Vectors are written as they are traced and not kept.
+    ConversionPipeline(PDFProcessor& processor, CADGenerator& generator);
+
+    void setOptions(const Options& options);
+    const Options& getOptions() const;
+
+    bool convert(const std::string& inputPath, const std::string& outputPath);
+
+    // Per-stage occupancy of the last convert(), also written to the log
+    const std::vector<Pipeline::StageStats>& getStats() const;
+    // How each page was traced, in page order; see PDFProcessor::Options::budget
+    const std::vector<PDFProcessor::PageReport>& getPageReports() const;
+
+private:
+    PDFProcessor& processor;
+    CADGenerator& generator;
+    Options options;
+    std::vector<Pipeline::StageStats> stats;
+    std::vector<PDFProcessor::PageReport> pageReports;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+// Long-running conversion service. Keeps Poppler, OpenCV and the log file warm
+// and runs jobs received over a local socket on a shared worker pool.
+// Uploaded PDFs and returned drawings stay in memory.
+//
+// Wire format, one job per connection:
+//   request:  "key value" lines terminated by an empty line, then
+//             `input-size` bytes of PDF data when the input is uploaded.
+//             Keys: input <path> | input-size <n>, output <path> (optional,
+//             the DXF is sent back when absent; paths are only accepted
+//             inside Config::pathRoot), compression
+//             none|gzip|zstd (default: from the output name), render-scale,
+//             quantization-grid, page-gap, vectorizer
+//             contours|segments|centerline, page-seconds, page-max-paths,
+//             page-max-entities (per-page budgets; pages over them are
+//             degraded and reported in a status line, raster fallbacks go
+//             next to the output; a returned DXF has no raster fallbacks,
+//             and pages that would need one are left empty).
+//   response: any number of "status <text>" lines, then either
+//             "ok <n>" followed by n bytes of DXF data (0 when written to
+//             `output`), or "error <message>".
+class ConversionServer {
+public:
+    struct Config {
+        std::string socketPath;
+        unsigned workerThreads = 0;                // 0 = one per hardware thread
+        size_t maxInputBytes = 512 * 1024 * 1024;  // Reject larger uploads
+        // Jobs may name input and output files only inside this directory,
+        // which the server reads and writes with its own privileges. Empty
+        // accepts uploads only.
+        std::string pathRoot;
+    };
+
+    explicit ConversionServer(const Config& config);
+    ~ConversionServer();
+
+    // Serves jobs until stop() is called
+    bool run();
+    // Safe to call from another thread, e.g. a console or signal handler
+    void stop();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+namespace pdf2cad {
+namespace model {
+class DocumentHeader;
+class Page;
+}
+}
+
+// Reads and writes document model files (see proto/document_model.proto):
+// a header followed by length-delimited pages.
+class DocumentModelWriter {
+public:
+    DocumentModelWriter();
+    ~DocumentModelWriter();
+
+    bool open(const std::string& path, const pdf2cad::model::DocumentHeader& header);
+    bool writePage(const pdf2cad::model::Page& page);
+    bool close();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl;
+};
+
+class DocumentModelReader {
+public:
+    DocumentModelReader();
+    ~DocumentModelReader();
+
+    // Opens the file and reads its header
+    bool open(const std::string& path);
+    const pdf2cad::model::DocumentHeader& getHeader() const;
+
+    // Both return false at the end of the file or on a truncated page
+    bool readPage(pdf2cad::model::Page& page);
+    bool skipPage();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+// Batch kernels over contiguous, interleaved (x, y) coordinate buffers.
+// Everything here works in a single pass and uses SSE2 where available.
+namespace geometry {
+
+// Millimetres per PDF point (1/72 inch)
+constexpr double kPointsToMillimeters = 25.4 / 72.0;
+
+// Per-axis affine map: x' = sx * x + tx, y' = sy * y + ty
+struct Transform {
+    double sx = 1.0;
+    double sy = 1.0;
+    double tx = 0.0;
+    double ty = 0.0;
+};
+
+struct Extents {
+    double minX = std::numeric_limits<double>::infinity();
+    double minY = std::numeric_limits<double>::infinity();
+    double maxX = -std::numeric_limits<double>::infinity();
+    double maxY = -std::numeric_limits<double>::infinity();
+
+    bool isValid() const { return minX <= maxX && minY <= maxY; }
+    void merge(const Extents& other);
+};
+
+// Maps pixels of a page rendered at `renderScale` pixels per point to
+// millimetres, flipping Y so the page's bottom-left corner lands on
+// (offsetX, offsetY).
+Transform makePageTransform(double pageHeightPoints, double renderScale,
+                            double offsetX, double offsetY);
+
+// Transforms `count` points in place, snaps them to `grid` when grid > 0 and
+// grows `extents` (may be null). Snapping rounds half to even and expects
+// |coordinate / grid| < 2^51.
+void transformPoints(double* xy, size_t count, const Transform& transform,
+                     double grid, Extents* extents);
+
+// Grows `extents` to cover `count` points.
+void accumulateExtents(const double* xy, size_t count, Extents& extents);
+
+} // namespace geometry
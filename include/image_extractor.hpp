@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+// Finds image XObjects through Poppler's core API and streams each unique
+// image to disk once. JPEG data is passed through undecoded; everything else
+// is decoded when first seen and written to a PNG one row at a time, so no
+// image is held in memory whole. Images are deduplicated by object reference
+// first and by content hash second.
+class ImageExtractor {
+public:
+    // One drawing of an image on a page, in PDF points from the page's
+    // bottom-left corner
+    struct Placement {
+        std::string path;
+        int pixelWidth;
+        int pixelHeight;
+        double x, y;    // Lower-left corner of the image
+        double uX, uY;  // One pixel along the image's width
+        double vX, vY;  // One pixel along the image's height
+    };
+
+    struct Stats {
+        size_t placements = 0;
+        size_t uniqueImages = 0;    // Files written
+        size_t passedThrough = 0;   // Of those, copied undecoded
+        size_t dedupedByRef = 0;    // Placements of an already exported XObject
+        size_t dedupedByHash = 0;   // Distinct XObjects with identical content
+        size_t failed = 0;
+    };
+
+    explicit ImageExtractor(const std::string& outputDirectory);
+    ~ImageExtractor();
+
+    bool open(const std::string& pdfPath);
+    // `data` must stay valid until the extractor is destroyed
+    bool open(const char* data, size_t size);
+    bool extractPage(int pageIndex, std::vector<Placement>& placements);
+
+    const Stats& getStats() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl;
+};
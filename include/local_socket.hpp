@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Minimal stream socket over a Unix domain socket path. Uses AF_UNIX on both
+// POSIX and Windows 10+ (afunix.h).
+class LocalSocket {
+public:
+    LocalSocket();
+    ~LocalSocket();
+
+    LocalSocket(LocalSocket&& other) noexcept;
+    LocalSocket& operator=(LocalSocket&& other) noexcept;
+    LocalSocket(const LocalSocket&) = delete;
+    LocalSocket& operator=(const LocalSocket&) = delete;
+
+    // Binds and listens on `path`. A socket file left by a server that is
+    // gone is replaced; any other file there, or a live server's socket,
+    // makes it fail.
+    bool listen(const std::string& path, int backlog = 64);
+    bool connect(const std::string& path);
+    LocalSocket accept();
+
+    bool sendAll(const char* data, size_t size);
+    bool sendAll(const std::string& data) { return sendAll(data.data(), data.size()); }
+    bool recvAll(char* data, size_t size);
+    // Reads up to and excluding '\n'. False at the end of the stream, and
+    // once kMaxLineBytes arrive without one.
+    bool readLine(std::string& line);
+    static constexpr size_t kMaxLineBytes = 64 * 1024;
+
+    bool isValid() const;
+    void close();
+
+private:
+    explicit LocalSocket(long long handle);
+
+    long long handle;
+    std::string boundPath;
+    std::string pending;  // Bytes read past the last line
+};
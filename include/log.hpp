@@ -0,0 +1,13 @@
+#pragma once
+
+#include <functional>
+
+// Diagnostics of the pdf2cad library. Each call formats one line, prefixed
+// with a local timestamp, and passes it to the handler. The default handler
+// prints it to stdout; applications embedding the library can redirect or
+// silence it. Safe to call from any thread; handlers are called one at a time.
+using LogHandler = std::function<void(const char* line)>;
+
+void setLogHandler(LogHandler handler);
+
+void log(const char* format, ...);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Destination for the bytes CADGenerator emits: a file, a memory buffer or a
+// sink of the caller's own. Compressing sinks encode the stream as it is
+// written, so a compressed drawing never exists uncompressed anywhere. With
+// `compressionThread` the encoder runs on its own thread, fed through two
+// swapping buffers while the writer fills the next one.
+class OutputSink {
+public:
+    enum class Compression {
+        Auto,  // From the file name: .gz = gzip, .zst = zstd, otherwise none
+        None,
+        Gzip,
+        Zstd
+    };
+
+    struct Options {
+        Compression compression = Compression::Auto;
+        int level = 0;                   // 0 = the codec's default level
+        bool compressionThread = false;  // Encode on a separate thread
+        size_t bufferBytes = 1 << 20;    // Size of each handoff buffer
+    };
+
+    struct Stats {
+        uint64_t bytesIn = 0;   // Uncompressed bytes written to the sink
+        uint64_t bytesOut = 0;  // Bytes that reached the file or buffer
+    };
+
+    virtual ~OutputSink() = default;
+
+    // Returns nullptr when the file cannot be created. The file is opened in
+    // binary mode: bytes reach it as written, so text keeps LF line endings
+    // on Windows too.
+    static std::unique_ptr<OutputSink> open(const std::string& path, const Options& options);
+    // Appends to `buffer`, which must outlive the sink. Auto compression
+    // means none, as there is no file name to go by.
+    static std::unique_ptr<OutputSink> toBuffer(std::string& buffer, const Options& options);
+    // Compresses into the caller's own sink, e.g. one that writes to a
+    // socket. finish() finishes `destination` too.
+    static std::unique_ptr<OutputSink> encodeTo(OutputSink& destination, const Options& options);
+
+    static Compression compressionForPath(const std::string& path);
+    static const char* compressionName(Compression compression);
+
+    // Both return false once any write to the destination has failed. Nothing
+    // may be written after finish(), which flushes the codec trailer and
+    // closes the file.
+    virtual bool write(const char* data, size_t size) = 0;
+    virtual bool finish() = 0;
+
+    virtual const Stats& getStats() const = 0;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Monotonic arena for data that only lives while one page is processed.
+// Allocation is a pointer bump, deallocation is a no-op, and release() drops
+// the whole page at once. The retained block grows to fit the largest page
+// seen, so steady-state pages never touch the heap, and shrinks back after
+// 16 pages in a row that fit a smaller one. Not thread-safe: use one arena
+// per worker.
+class PageArena {
+public:
+    struct Stats {
+        size_t releases = 0;             // Calls to release(), one per trace attempt of a page
+        size_t allocations = 0;          // Requests served by the arena
+        size_t bytesAllocated = 0;       // Bytes handed out over all pages
+        size_t peakPageBytes = 0;        // Most allocated between two releases
+        size_t upstreamAllocations = 0;  // Times the arena fell back to the heap
+        size_t upstreamBytes = 0;
+        size_t retainedBytes = 0;        // Block kept between pages
+    };
+
+    explicit PageArena(size_t initialBytes = 256 * 1024);
+    ~PageArena();
+
+    PageArena(const PageArena&) = delete;
+    PageArena& operator=(const PageArena&) = delete;
+
+    std::pmr::memory_resource* resource();
+
+    // Frees everything allocated since the last release
+    void release();
+
+    const Stats& getStats() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pimpl;
+};
@@ -1,8 +1,17 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 #include <memory>
+#include "geometry_kernels.hpp"
+#include "page_arena.hpp"
+#include "raster_vectorizer.hpp"
+
+namespace poppler {
+class page;
+class page_renderer;
+}
 
 class PDFProcessor {
 public:
@@ -10,9 +19,42 @@ public:
     ~PDFProcessor();
 
     bool loadPDF(const std::string& filepath);
+    // Loads a PDF held in memory without copying it; `data` must stay valid
+    // and unchanged for as long as this processor uses the document
+    bool loadPDFFromMemory(const char* data, size_t size);
     bool extractVectors();
     bool extractText();
     bool extractImages();
+
+    // Limits on what a single page may cost; 0 disables a limit. A page
+    // over budget is traced again with cheaper settings: its paths are
+    // simplified, then it is traced at half the resolution (repeatedly, down
+    // to minRenderScale), and as a last resort it is embedded as a raster
+    // IMAGE. Tracing stops as soon as a page has more than maxPaths paths or
+    // runs out of time; once a page is out of time, the next retry is the
+    // raster.
+    struct PageBudget {
+        double maxSeconds = 0.0;         // Wall time to render and trace one page
+        size_t maxPaths = 0;             // Contours (or segments) traced on one page
+        size_t maxEntities = 0;          // Entities emitted for one page
+        double simplifyTolerance = 1.5;  // Pixels; Douglas-Peucker tolerance of the first fallback
+        double minRenderScale = 1.0;     // Lowest resolution the page is traced at, at least 0.125
+        double rasterScale = 2.0;        // Resolution of the raster fallback image
+        bool rasterFallback = true;      // False leaves a page empty rather than write an image
+    };
+
+    struct Options {
+        double renderScale = 4.0;       // Render resolution as a multiple of 72 DPI
+        double quantizationGrid = 0.0;  // Snap coordinates to this grid in mm (0 disables)
+        double pageGap = 10.0;          // Horizontal gap between pages in mm
+        std::string imageDirectory = "images";  // Where extractImages() writes image files
+        RasterVectorizer::Backend vectorizer = RasterVectorizer::Backend::Contours;
+        RasterVectorizer::Options vectorizerOptions;
+        PageBudget budget;
+    };
+
+    void setOptions(const Options& options);
+    const Options& getOptions() const;
     
     struct VectorElement {
         enum class Type {
@@ -22,15 +64,91 @@ public:
             RECTANGLE
         };
         Type type;
-        std::vector<double> points;
+        // Both endpoints, x0 y0 x1 y1 in mm. Inline so an element costs no
+        // allocation of its own; pages produce millions of them. This used to
+        // be a std::vector<double>: callers that sized or pushed onto it now
+        // fill the four coordinates directly.
+        std::array<double, 4> points;
+        // Stroke width in mm, 0 when the vectorizer does not measure it.
+        // Extraction used to store a placeholder 1.0 for every element; 0 now
+        // means unknown, and the DXF writes such lines ByLayer (lineweight -1).
         double thickness;
+        int page = 0;      // Zero-based source page
+    };
+
+    // One placement of an embedded image. Repeated placements of the same
+    // image share one file.
+    struct ImageElement {
+        std::string path;
+        int pixelWidth;
+        int pixelHeight;
+        double x, y;    // Lower-left corner in drawing units
+        double uX, uY;  // One pixel along the image's width
+        double vX, vY;  // One pixel along the image's height
+        int page = 0;
     };
 
+    // How one page was traced
+    struct PageReport {
+        enum class Outcome {
+            Full,             // Within budget as rendered
+            Simplified,       // Paths simplified at full resolution
+            LowerResolution,  // Traced at renderScale below Options::renderScale
+            Raster,           // Embedded as an image instead of vectors
+            Failed            // Not rendered, or not rasterized; the page is empty
+        };
+        int page = 0;
+        Outcome outcome = Outcome::Full;
+        double renderScale = 0.0;  // Resolution of the kept result
+        size_t paths = 0;          // Of the first attempt, up to where it stopped
+        size_t entities = 0;       // Emitted for the page
+        double seconds = 0.0;      // Rendering included
+        std::string reason;        // The limit exceeded first: paths, entities or time
+    };
+    static const char* outcomeName(PageReport::Outcome outcome);
+
     const std::vector<VectorElement>& getVectors() const { return getVectorElements(); }
     const std::vector<std::string>& getText() const { return getTextElements(); }
 
     const std::vector<VectorElement>& getVectorElements() const;
     const std::vector<std::string>& getTextElements() const;
+    const std::vector<ImageElement>& getImageElements() const;
+
+    // Writes everything extracted so far as a document model file (see
+    // proto/document_model.proto), one page at a time. CADGenerator::importModel()
+    // reads it back, so extraction can run once for several outputs.
+    bool exportModel(const std::string& path);
+
+    // One report per page traced by extractVectors()
+    const std::vector<PageReport>& getPageReports() const;
+
+    // Allocation statistics for per-page scratch memory
+    const PageArena::Stats& getArenaStats() const;
+
+    // X offset of each page in the drawing, in mm
+    const std::vector<double>& getPageOffsets();
+
+    // Per-page building blocks of extractVectors() and extractText(). They
+    // touch no processor state, so a pipeline can run them on its own
+    // threads with its own document, renderer and vectorizer.
+    static void setRenderHints(poppler::page_renderer& renderer);
+    static bool renderPageGray(poppler::page_renderer& renderer, poppler::page& page,
+                               double renderScale, cv::Mat& gray);
+    // Transforms the paths to drawing units in place and appends their
+    // segments to `out`
+    static void commitPagePaths(RasterPaths& paths, const geometry::Transform& transform,
+                                double quantizationGrid, int page,
+                                std::vector<VectorElement>& out, geometry::Extents& extents);
+    // Traces a page rendered at options.renderScale within options.budget,
+    // which `renderSeconds` already counts against. Vectors go to `vectors`;
+    // a raster fallback is written to options.imageDirectory and goes to
+    // `images`.
+    static PageReport tracePage(const cv::Mat& gray, int page, double heightPoints, double offsetX,
+                                double renderSeconds, const Options& options,
+                                RasterVectorizer& vectorizer, PageArena& arena,
+                                std::vector<VectorElement>& vectors,
+                                std::vector<ImageElement>& images, geometry::Extents& extents);
+    static std::string pageText(poppler::page& page);
 
 private:
     class Impl;
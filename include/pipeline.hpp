@@ -0,0 +1,239 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bounded multi-producer multi-consumer queue. push() blocks while the queue
+// is full, which is what throttles a fast stage to the pace of the next one.
+template <typename T>
+class BoundedQueue {
+public:
+    struct Stats {
+        size_t pushed = 0;
+        size_t highWater = 0;  // Most items ever waiting at once
+    };
+
+    explicit BoundedQueue(size_t capacity) : capacity(capacity < 1 ? 1 : capacity) {}
+
+    // False when the queue was closed; the item is dropped
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        stats.pushed++;
+        stats.highWater = std::max(stats.highWater, items.size());
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // False once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Producers are done: pop() drains what is left, push() fails
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    // Cancellation: also drops what is still queued
+    void abort() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        items.clear();
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    Stats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    size_t getCapacity() const { return capacity; }
+
+private:
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    bool closed = false;
+    Stats stats;
+};
+
+// Runs stages connected by BoundedQueues, each stage on its own set of
+// worker threads. A stage's output queue is closed once all of its workers
+// are done, so completion flows downstream. A failing or throwing stage
+// aborts every queue and the whole pipeline unwinds.
+//
+// Each worker's time is split into busy (running the stage function),
+// starved (waiting on its input) and blocked (waiting for room in its
+// output); occupancy is busy time over workers x wall time.
+class Pipeline {
+public:
+    struct StageStats {
+        std::string name;
+        unsigned workers = 0;
+        size_t items = 0;
+        double busySeconds = 0.0;
+        double starvedSeconds = 0.0;
+        double blockedSeconds = 0.0;
+        size_t queueCapacity = 0;   // Of the output queue, 0 for the last stage
+        size_t queueHighWater = 0;
+        double occupancy = 0.0;
+    };
+
+    // Producer stage: `work(emit)` runs once per worker and emits items until
+    // it returns. Returning false fails the pipeline.
+    template <typename Out>
+    void addSource(const std::string& name, unsigned workers, BoundedQueue<Out>& output,
+                   std::function<bool(const std::function<bool(Out)>& emit)> work) {
+        Stage& stage = newStage(name, workers);
+        stage.abortQueue = [&output] { output.abort(); };
+        stage.closeOutput = [&output] { output.close(); };
+        stage.outputStats = [&output](StageStats& stats) {
+            stats.queueCapacity = output.getCapacity();
+            stats.queueHighWater = output.getStats().highWater;
+        };
+        stage.body = [&output, work](Counters& counters) {
+            auto emit = makeEmit(output, counters, true);
+            Clock::time_point start = Clock::now();
+            bool ok = work(emit);
+            counters.busy += Clock::now() - start;  // Minus emit waits, see makeEmit
+            return ok;
+        };
+    }
+
+    // Transform stage: `work(item, emit)` per input item; it may emit any
+    // number of outputs
+    template <typename In, typename Out>
+    void addStage(const std::string& name, unsigned workers, BoundedQueue<In>& input,
+                  BoundedQueue<Out>& output,
+                  std::function<bool(In& item, const std::function<bool(Out)>& emit)> work) {
+        Stage& stage = newStage(name, workers);
+        stage.abortQueue = [&output] { output.abort(); };
+        stage.closeOutput = [&output] { output.close(); };
+        stage.outputStats = [&output](StageStats& stats) {
+            stats.queueCapacity = output.getCapacity();
+            stats.queueHighWater = output.getStats().highWater;
+        };
+        stage.body = [&input, &output, work](Counters& counters) {
+            auto emit = makeEmit(output, counters, false);
+            return consume(input, counters, [&](In& item) { return work(item, emit); });
+        };
+        abortInputs.push_back([&input] { input.abort(); });
+    }
+
+    // Final stage: `work(item)` per input item
+    template <typename In>
+    void addSink(const std::string& name, unsigned workers, BoundedQueue<In>& input,
+                 std::function<bool(In& item)> work) {
+        Stage& stage = newStage(name, workers);
+        stage.body = [&input, work](Counters& counters) {
+            return consume(input, counters, work);
+        };
+        abortInputs.push_back([&input] { input.abort(); });
+    }
+
+    // Called when a stage fails, beside aborting the queues, to release
+    // anything else a worker may be waiting on
+    void onAbort(std::function<void()> handler) {
+        abortInputs.push_back(std::move(handler));
+    }
+
+    // Runs all stages to completion; false if any stage failed
+    bool run();
+
+    const std::vector<StageStats>& getStats() const { return stats; }
+    double getWallSeconds() const { return wallSeconds; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Counters {
+        size_t items = 0;
+        Clock::duration busy{};
+        Clock::duration starved{};
+        Clock::duration blocked{};
+    };
+
+    struct Stage {
+        std::string name;
+        unsigned workers = 1;
+        std::function<bool(Counters&)> body;
+        std::function<void()> closeOutput;
+        std::function<void()> abortQueue;
+        std::function<void(StageStats&)> outputStats;
+    };
+
+    Stage& newStage(const std::string& name, unsigned workers) {
+        stages.push_back(std::make_unique<Stage>());
+        stages.back()->name = name;
+        stages.back()->workers = workers < 1 ? 1 : workers;
+        return *stages.back();
+    }
+
+    // Push that books its wait as blocked time and takes it out of busy time.
+    // Sources count the items they emit, other stages the items they take.
+    template <typename Out>
+    static std::function<bool(Out)> makeEmit(BoundedQueue<Out>& output, Counters& counters,
+                                             bool countItems) {
+        return [&output, &counters, countItems](Out item) {
+            Clock::time_point start = Clock::now();
+            bool ok = output.push(std::move(item));
+            Clock::duration waited = Clock::now() - start;
+            counters.blocked += waited;
+            counters.busy -= waited;
+            counters.items += countItems ? 1 : 0;
+            return ok;
+        };
+    }
+
+    template <typename In, typename Work>
+    static bool consume(BoundedQueue<In>& input, Counters& counters, Work&& work) {
+        for (;;) {
+            In item;
+            Clock::time_point start = Clock::now();
+            bool got = input.pop(item);
+            Clock::time_point popped = Clock::now();
+            counters.starved += popped - start;
+            if (!got) {
+                return true;
+            }
+            counters.items++;
+            bool ok = work(item);
+            counters.busy += Clock::now() - popped;
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::vector<std::function<void()>> abortInputs;
+    std::vector<StageStats> stats;
+    double wallSeconds = 0.0;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Paths found on a rendered page, in pixel coordinates. Stored flat so a
+// whole page can be transformed to drawing units in one batch.
+struct RasterPaths {
+    explicit RasterPaths(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : coords(resource), starts(1, 0, resource), closed(resource), widths(resource) {}
+
+    std::pmr::vector<double> coords;  // x, y pairs of every path, back to back
+    std::pmr::vector<size_t> starts;  // First point of each path, plus the end
+    std::pmr::vector<char> closed;
+    std::pmr::vector<float> widths;   // Stroke width of each path in pixels, 0 if not measured
+
+    size_t pathCount() const { return closed.size(); }
+    size_t pointCount() const { return coords.size() / 2; }
+
+    // LINE entities these paths become: one per segment, plus the closing
+    // segment of closed paths
+    size_t segmentCount() const {
+        size_t segments = 0;
+        for (size_t p = 0; p < pathCount(); ++p) {
+            size_t points = starts[p + 1] - starts[p];
+            if (points >= 2) {
+                segments += points - 1 + (closed[p] ? 1 : 0);
+            }
+        }
+        return segments;
+    }
+
+    // Call addPoint() for the path's points, then endPath()
+    void addPoint(double x, double y) {
+        coords.push_back(x);
+        coords.push_back(y);
+    }
+    void endPath(bool isClosed, float width = 0.0f) {
+        starts.push_back(coords.size() / 2);
+        closed.push_back(isClosed ? 1 : 0);
+        widths.push_back(width);
+    }
+
+    void clear() {
+        coords.clear();
+        starts.assign(1, 0);
+        closed.clear();
+        widths.clear();
+    }
+
+    // Douglas-Peucker in place: drops points closer than `tolerance` pixels
+    // to the simplified path. Endpoints are always kept. Paths before
+    // `firstPath` are left alone.
+    void simplify(double tolerance, size_t firstPath = 0);
+};
+
+// Turns a rendered page (8-bit gray, dark ink on white) into paths.
+class RasterVectorizer {
+public:
+    enum class Backend {
+        Contours,   // Canny edges traced with findContours; one outline per stroke edge
+        Segments,   // Line segment detector; straight segments with their endpoints
+        Centerline  // Ink thinned to one-pixel centre lines; one path per stroke, with its width
+    };
+
+    struct Options {
+        unsigned threads = 0;            // Threads working on one page, 0 = one per hardware thread
+        int minBandRows = 256;           // Bands are never shorter than this
+        double angleTolerance = 1.0;     // Degrees; segments closer in angle may merge
+        double distanceTolerance = 3.0;  // Pixels; covers both edges of a stroke this wide
+        double gapBridge = 2.0;          // Pixels; collinear segments with smaller gaps join
+        double minLength = 2.0;          // Pixels; shorter segments and centre lines are dropped
+        int inkThreshold = 0;            // Centerline: gray levels up to this are ink, 0 = Otsu
+        double simplifyTolerance = 1.0;  // Pixels; centre lines are simplified to within this
+    };
+
+    // Where a trace gives up on a page that costs too much
+    struct Limits {
+        size_t maxPaths = 0;  // More paths than this stops the trace, 0 = no limit
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+        bool reached(size_t pathCount) const {
+            return (maxPaths > 0 && pathCount > maxPaths) ||
+                (deadline != std::chrono::steady_clock::time_point::max() &&
+                 std::chrono::steady_clock::now() > deadline);
+        }
+    };
+
+    virtual ~RasterVectorizer() = default;
+
+    static std::unique_ptr<RasterVectorizer> create(Backend backend, const Options& options);
+    static const char* backendName(Backend backend);
+
+    // Appends the page's paths to `paths`. False when it stopped at one of
+    // `limits`, leaving only the paths found by then.
+    virtual bool vectorize(const cv::Mat& gray, RasterPaths& paths, const Limits& limits) = 0;
+    void vectorize(const cv::Mat& gray, RasterPaths& paths) { vectorize(gray, paths, Limits()); }
+};
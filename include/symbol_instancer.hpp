@@ -0,0 +1,55 @@
+#pragma once
+
+#include "pdf_processor.hpp"
+#include <string>
+#include <vector>
+
+// Finds shapes that repeat across a drawing (doors, fixtures, grid bubbles)
+// so they can be written once as a BLOCK and placed with INSERTs.
+//
+// Line segments are grouped into connected clusters, each cluster is brought
+// to a canonical pose (centroid at the origin, principal axis along X, unit
+// RMS radius), quantized and hashed along with each segment's stroke width.
+// Clusters with identical canonical geometry and widths become instances of
+// one block. Mirrored copies are not matched.
+class SymbolInstancer {
+public:
+    struct Options {
+        double joinTolerance = 0.05;  // Endpoints closer than this (mm) connect segments
+        size_t minSegments = 3;       // Smaller clusters are left as plain lines
+        size_t maxSegments = 5000;    // Larger clusters are structure, not symbols
+        size_t minInstances = 2;      // A shape must repeat to become a block
+        double shapeQuantum = 0.005;  // Canonical coordinate grid, in RMS radii
+        double widthQuantum = 0.01;   // Stroke width grid in mm, one DXF lineweight unit
+        bool allowScaling = true;     // Match copies at different sizes
+    };
+
+    struct Block {
+        std::string name;
+        std::vector<double> segments;  // x1, y1, x2, y2 per segment, block coordinates
+        std::vector<double> widths;    // Stroke width in mm per segment, 0 if not measured
+        size_t instances = 0;
+    };
+
+    struct Insert {
+        size_t block;
+        double x, y;      // Insertion point in drawing units
+        double scale;
+        double rotation;  // Degrees, counter-clockwise
+    };
+
+    struct Result {
+        std::vector<Block> blocks;
+        std::vector<Insert> inserts;
+        std::vector<bool> instanced;  // Per input element: drawn by an INSERT
+        size_t instancedSegments = 0;
+    };
+
+    SymbolInstancer();
+    explicit SymbolInstancer(const Options& options);
+
+    Result detect(const std::vector<PDFProcessor::VectorElement>& vectors) const;
+
+private:
+    Options options;
+};
@@ -1,34 +1,163 @@
 #include "cad_generator.hpp"
-#include <fstream>
+#include "geometry_kernels.hpp"
+#include "output_sink.hpp"
+#include "symbol_instancer.hpp"
+#include "document_model.hpp"
+#include "log.hpp"
+#include "document_model.pb.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <cstring>  // For strcmp
 
-// Forward declaration of the log function
-extern void log(const char* format, ...);
+namespace {
+
+// Each group code and value go on separate lines
+void appendGroup(std::string& out, int code, const std::string& value) {
+    out += std::to_string(code);
+    out += '\n';
+    out += value;
+    out += '\n';
+}
+
+// Formats like std::to_string(double) without the temporary string
+void appendGroup(std::string& out, int code, double value) {
+    char buffer[64];
+    int length = snprintf(buffer, sizeof(buffer), "%d\n%f\n", code, value);
+    out.append(buffer, static_cast<size_t>(length));
+}
+
+// DXF handles are upper-case hex
+std::string toHandle(unsigned long long handle) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%llX", handle);
+    return buffer;
+}
+
+// The DXF lineweight (hundredths of a mm) nearest a stroke width in mm
+int lineweight(double millimeters) {
+    static const int standard[] = {
+        0, 5, 9, 13, 15, 18, 20, 25, 30, 35, 40, 50, 53, 60, 70, 80, 90, 100, 106, 120, 140, 158, 200, 211
+    };
+    const double hundredths = millimeters * 100.0;
+    int best = standard[0];
+    for (int weight : standard) {
+        if (std::abs(weight - hundredths) < std::abs(best - hundredths)) {
+            best = weight;
+        }
+    }
+    return best;
+}
+
+// Group 370 for a stroke width; -1 (ByLayer) when the width was not measured
+std::string lineweightValue(double millimeters) {
+    return millimeters > 0.0 ? std::to_string(lineweight(millimeters)) : "-1";
+}
+
+void appendLine(std::string& out, const PDFProcessor::VectorElement& vec, const std::string& handle) {
+    appendGroup(out, 0, "LINE");
+    appendGroup(out, 5, handle);
+    appendGroup(out, 330, "1F");
+    appendGroup(out, 100, "AcDbEntity");
+    appendGroup(out, 8, "0");
+    appendGroup(out, 370, lineweightValue(vec.thickness));
+    appendGroup(out, 100, "AcDbLine");
+    appendGroup(out, 10, vec.points[0]);
+    appendGroup(out, 20, vec.points[1]);
+    appendGroup(out, 30, "0.0");
+    appendGroup(out, 11, vec.points[2]);
+    appendGroup(out, 21, vec.points[3]);
+    appendGroup(out, 31, "0.0");
+}
+
+} // namespace
 
 class CADGenerator::Impl {
 public:
     std::vector<PDFProcessor::VectorElement> vectors;
     std::vector<std::string> texts;
-    int nextHandle = 100;  // Start with a higher handle number
+    std::vector<PDFProcessor::ImageElement> images;
+    Options options;
+    unsigned long long nextHandle = 100;  // Start with a higher handle number
+
+    // One entry per entity in the ENTITIES section, in output order
+    struct EntityRef {
+        enum class Kind { Image, Line, Insert, Text };
+        Kind kind;
+        size_t index;
+    };
+
+    // Raster images: one IMAGEDEF per distinct file, one IMAGEDEF_REACTOR per
+    // IMAGE. Filled in before any formatting starts.
+    struct ImageObjects {
+        std::vector<std::string> defPaths;  // As written, relative to the DXF
+        std::vector<size_t> defOfImage;
+        unsigned long long firstImageHandle = 0;  // Images are consecutive entities
+        unsigned long long dictHandle = 0;
+        unsigned long long firstDefHandle = 0;
+        unsigned long long firstReactorHandle = 0;
+    } imageObjects;
+
+    // Repeated shapes found by the SymbolInstancer, when enabled
+    SymbolInstancer::Result symbols;
+
+    // LINE entities streamed by streamVectors(), waiting in a scratch file
+    // until finishStream() knows the extents and handle count for the header
+    struct Spool {
+        std::string outputPath;
+        std::string path;
+        std::unique_ptr<OutputSink> sink;
+        unsigned long long firstHandle = 0;
+        unsigned long long nextHandle = 0;
+        geometry::Extents extents;
+        std::string buffer;
+    } spool;
 
     std::string getNextHandle() {
-        return std::to_string(nextHandle++);
+        return toHandle(nextHandle++);
     }
 
-    bool writeDXF(const std::string& outputPath) {
-        log("Attempting to write DXF file: %s", outputPath.c_str());
-        std::ofstream file(outputPath);
-        if (!file) {
-            log("Failed to open output file for writing");
-            return false;
+    // Bounding box of everything written to the ENTITIES section, on top of
+    // what was already streamed
+    geometry::Extents computeExtents(geometry::Extents extents = geometry::Extents()) const {
+        for (const auto& vec : vectors) {
+            geometry::accumulateExtents(vec.points.data(), vec.points.size() / 2, extents);
+        }
+        for (const auto& image : images) {
+            const double corners[] = {
+                image.x, image.y,
+                image.x + image.uX * image.pixelWidth, image.y + image.uY * image.pixelWidth,
+                image.x + image.vX * image.pixelHeight, image.y + image.vY * image.pixelHeight,
+                image.x + image.uX * image.pixelWidth + image.vX * image.pixelHeight,
+                image.y + image.uY * image.pixelWidth + image.vY * image.pixelHeight
+            };
+            geometry::accumulateExtents(corners, 4, extents);
         }
+        if (!texts.empty()) {
+            const double textAnchors[] = {0.0, 0.0, 0.0, 3.0 * (texts.size() - 1)};
+            geometry::accumulateExtents(textAnchors, 2, extents);
+        }
+        if (!extents.isValid()) {
+            // Empty drawing, fall back to the drawing limits
+            extents.minX = extents.minY = 0.0;
+            extents.maxX = 420.0;
+            extents.maxY = 297.0;
+        }
+        return extents;
+    }
 
-        // Write each group code and value on separate lines
-        auto writeGroup = [&file](int code, const std::string& value) {
-            file << code << "\n" << value << "\n";
+    std::string formatHeader(const geometry::Extents& extents, const std::string& handseed) {
+        std::string out;
+        auto writeGroup = [&out](int code, const std::string& value) {
+            appendGroup(out, code, value);
         };
 
-        log("Writing DXF header...");
         // Write DXF header
         writeGroup(0, "SECTION");
         writeGroup(2, "HEADER");
@@ -43,13 +172,13 @@ public:
         writeGroup(20, "0.0");
         writeGroup(30, "0.0");
         writeGroup(9, "$EXTMIN");
-        writeGroup(10, "-100.0");  // Expanded drawing limits
-        writeGroup(20, "-100.0");
-        writeGroup(30, "-100.0");
+        writeGroup(10, std::to_string(extents.minX));
+        writeGroup(20, std::to_string(extents.minY));
+        writeGroup(30, "0.0");
         writeGroup(9, "$EXTMAX");
-        writeGroup(10, "3000.0");  // Expanded drawing limits
-        writeGroup(20, "2000.0");
-        writeGroup(30, "100.0");
+        writeGroup(10, std::to_string(extents.maxX));
+        writeGroup(20, std::to_string(extents.maxY));
+        writeGroup(30, "0.0");
         writeGroup(9, "$LIMMIN");
         writeGroup(10, "0.0");
         writeGroup(20, "0.0");
@@ -57,7 +186,7 @@ public:
         writeGroup(10, "420.0");
         writeGroup(20, "297.0");
         writeGroup(9, "$HANDSEED");
-        writeGroup(5, "FF");
+        writeGroup(5, handseed);
         writeGroup(9, "$MEASUREMENT");
         writeGroup(70, "1");
         writeGroup(9, "$LUNITS");
@@ -65,10 +194,36 @@ public:
         writeGroup(9, "$AUNITS");
         writeGroup(70, "0");
         writeGroup(0, "ENDSEC");
+        return out;
+    }
+
+    // CLASSES, TABLES and BLOCKS sections
+    std::string formatTablesAndBlocks() {
+        std::string out;
+        auto writeGroup = [&out](int code, const std::string& value) {
+            appendGroup(out, code, value);
+        };
 
         // Write CLASSES section (required for AC1032)
         writeGroup(0, "SECTION");
         writeGroup(2, "CLASSES");
+        if (!images.empty()) {
+            const char* classes[][3] = {
+                {"IMAGE", "AcDbRasterImage", "127"},
+                {"IMAGEDEF", "AcDbRasterImageDef", "0"},
+                {"IMAGEDEF_REACTOR", "AcDbRasterImageDefReactor", "1"}
+            };
+            for (const auto& cls : classes) {
+                writeGroup(0, "CLASS");
+                writeGroup(1, cls[0]);
+                writeGroup(2, cls[1]);
+                writeGroup(3, "ISM");
+                writeGroup(90, cls[2]);
+                writeGroup(91, "0");
+                writeGroup(280, "0");
+                writeGroup(281, strcmp(cls[0], "IMAGE") == 0 ? "1" : "0");
+            }
+        }
         writeGroup(0, "ENDSEC");
 
         // Write TABLES section
@@ -208,6 +363,31 @@ public:
             writeGroup(0, "ENDTAB");
         }
 
+        // BLOCK_RECORD table, owner of every block's contents
+        std::string blockTableHandle = getNextHandle();
+        writeGroup(0, "TABLE");
+        writeGroup(2, "BLOCK_RECORD");
+        writeGroup(5, blockTableHandle);
+        writeGroup(330, "0");
+        writeGroup(100, "AcDbSymbolTable");
+        writeGroup(70, std::to_string(2 + symbols.blocks.size()));
+        std::vector<std::pair<std::string, std::string>> blockRecords = {
+            {"*MODEL_SPACE", "1F"},
+            {"*PAPER_SPACE", "1B"}
+        };
+        for (const auto& block : symbols.blocks) {
+            blockRecords.emplace_back(block.name, getNextHandle());
+        }
+        for (const auto& record : blockRecords) {
+            writeGroup(0, "BLOCK_RECORD");
+            writeGroup(5, record.second);
+            writeGroup(330, blockTableHandle);
+            writeGroup(100, "AcDbSymbolTableRecord");
+            writeGroup(100, "AcDbBlockTableRecord");
+            writeGroup(2, record.first);
+        }
+        writeGroup(0, "ENDTAB");
+
         writeGroup(0, "ENDSEC");
 
         // Write BLOCKS section
@@ -255,62 +435,352 @@ public:
         writeGroup(100, "AcDbEntity");
         writeGroup(8, "0");
         writeGroup(100, "AcDbBlockEnd");
-        
-        writeGroup(0, "ENDSEC");
-
-        log("Writing entities section...");
-        // Write ENTITIES section
-        writeGroup(0, "SECTION");
-        writeGroup(2, "ENTITIES");
 
-        // Write vector elements
-        log("Writing %zu vector elements...", vectors.size());
-        for (const auto& vec : vectors) {
-            if (vec.type == PDFProcessor::VectorElement::Type::LINE) {
+        // Symbol blocks, in block coordinates around their base point
+        for (size_t b = 0; b < symbols.blocks.size(); ++b) {
+            const auto& block = symbols.blocks[b];
+            const std::string& owner = blockRecords[2 + b].second;
+            writeGroup(0, "BLOCK");
+            writeGroup(5, getNextHandle());
+            writeGroup(330, owner);
+            writeGroup(100, "AcDbEntity");
+            writeGroup(8, "0");
+            writeGroup(100, "AcDbBlockBegin");
+            writeGroup(2, block.name);
+            writeGroup(70, "0");
+            writeGroup(10, "0.0");
+            writeGroup(20, "0.0");
+            writeGroup(30, "0.0");
+            writeGroup(3, block.name);
+            writeGroup(1, "");
+            for (size_t i = 0; i + 3 < block.segments.size(); i += 4) {
                 writeGroup(0, "LINE");
                 writeGroup(5, getNextHandle());
-                writeGroup(330, "1F");
+                writeGroup(330, owner);
                 writeGroup(100, "AcDbEntity");
                 writeGroup(8, "0");
+                // Not scaled by the INSERT, like the lines it replaces
+                writeGroup(370, lineweightValue(block.widths[i / 4]));
                 writeGroup(100, "AcDbLine");
-                writeGroup(10, std::to_string(vec.points[0]));
-                writeGroup(20, std::to_string(vec.points[1]));
+                appendGroup(out, 10, block.segments[i]);
+                appendGroup(out, 20, block.segments[i + 1]);
                 writeGroup(30, "0.0");
-                writeGroup(11, std::to_string(vec.points[2]));
-                writeGroup(21, std::to_string(vec.points[3]));
+                appendGroup(out, 11, block.segments[i + 2]);
+                appendGroup(out, 21, block.segments[i + 3]);
                 writeGroup(31, "0.0");
-                log("  Added line from (%.2f,%.2f) to (%.2f,%.2f)", 
-                    vec.points[0], vec.points[1], vec.points[2], vec.points[3]);
             }
-        }
-
-        // Write text elements with proper positioning
-        log("Writing %zu text elements...", texts.size());
-        double textY = 0.0;
-        for (const auto& text : texts) {
-            writeGroup(0, "TEXT");
+            writeGroup(0, "ENDBLK");
             writeGroup(5, getNextHandle());
-            writeGroup(330, "1F");
+            writeGroup(330, owner);
             writeGroup(100, "AcDbEntity");
             writeGroup(8, "0");
-            writeGroup(100, "AcDbText");
-            writeGroup(10, "0.0");
-            writeGroup(20, std::to_string(textY));
-            writeGroup(30, "0.0");
-            writeGroup(40, "2.5");
-            writeGroup(1, text);
-            writeGroup(50, "0.0");
-            writeGroup(41, "1.0");
-            writeGroup(7, "STANDARD");
-            writeGroup(71, "0");
-            writeGroup(72, "0");
-            writeGroup(73, "0");
-            writeGroup(100, "AcDbText");
-            log("  Added text at (0.0,%.2f): %s", textY, text.c_str());
-            textY += 3.0;
+            writeGroup(100, "AcDbBlockEnd");
         }
-
+        
         writeGroup(0, "ENDSEC");
+        return out;
+    }
+
+    std::vector<EntityRef> collectEntities() const {
+        std::vector<EntityRef> entities;
+        entities.reserve(images.size() + vectors.size() + symbols.inserts.size() + texts.size());
+        // Images first so vectors draw on top of them
+        for (size_t i = 0; i < images.size(); ++i) {
+            entities.push_back({EntityRef::Kind::Image, i});
+        }
+        for (size_t i = 0; i < vectors.size(); ++i) {
+            bool instanced = !symbols.instanced.empty() && symbols.instanced[i];
+            if (vectors[i].type == PDFProcessor::VectorElement::Type::LINE && !instanced) {
+                entities.push_back({EntityRef::Kind::Line, i});
+            }
+        }
+        for (size_t i = 0; i < symbols.inserts.size(); ++i) {
+            entities.push_back({EntityRef::Kind::Insert, i});
+        }
+        for (size_t i = 0; i < texts.size(); ++i) {
+            entities.push_back({EntityRef::Kind::Text, i});
+        }
+        return entities;
+    }
+
+    // Formats entities [begin, end); entity i gets handle firstHandle + i, so
+    // any split into chunks produces the same bytes
+    void formatEntities(const std::vector<EntityRef>& entities, size_t begin, size_t end,
+                        unsigned long long firstHandle, std::string& out) const {
+        auto writeGroup = [&out](int code, const std::string& value) {
+            appendGroup(out, code, value);
+        };
+
+        for (size_t i = begin; i < end; ++i) {
+            std::string handle = toHandle(firstHandle + i);
+            const EntityRef& entity = entities[i];
+            if (entity.kind == EntityRef::Kind::Line) {
+                appendLine(out, vectors[entity.index], handle);
+            } else if (entity.kind == EntityRef::Kind::Insert) {
+                const auto& insert = symbols.inserts[entity.index];
+                writeGroup(0, "INSERT");
+                writeGroup(5, handle);
+                writeGroup(330, "1F");
+                writeGroup(100, "AcDbEntity");
+                writeGroup(8, "0");
+                writeGroup(100, "AcDbBlockReference");
+                writeGroup(2, symbols.blocks[insert.block].name);
+                appendGroup(out, 10, insert.x);
+                appendGroup(out, 20, insert.y);
+                writeGroup(30, "0.0");
+                appendGroup(out, 41, insert.scale);
+                appendGroup(out, 42, insert.scale);
+                writeGroup(43, "1.0");
+                appendGroup(out, 50, insert.rotation);
+            } else if (entity.kind == EntityRef::Kind::Image) {
+                const auto& image = images[entity.index];
+                writeGroup(0, "IMAGE");
+                writeGroup(5, handle);
+                writeGroup(330, "1F");
+                writeGroup(100, "AcDbEntity");
+                writeGroup(8, "0");
+                writeGroup(100, "AcDbRasterImage");
+                writeGroup(90, "0");
+                appendGroup(out, 10, image.x);
+                appendGroup(out, 20, image.y);
+                writeGroup(30, "0.0");
+                appendGroup(out, 11, image.uX);
+                appendGroup(out, 21, image.uY);
+                writeGroup(31, "0.0");
+                appendGroup(out, 12, image.vX);
+                appendGroup(out, 22, image.vY);
+                writeGroup(32, "0.0");
+                appendGroup(out, 13, static_cast<double>(image.pixelWidth));
+                appendGroup(out, 23, static_cast<double>(image.pixelHeight));
+                writeGroup(340, toHandle(imageObjects.firstDefHandle + imageObjects.defOfImage[entity.index]));
+                writeGroup(70, "3");
+                writeGroup(280, "0");
+                writeGroup(281, "50");
+                writeGroup(282, "50");
+                writeGroup(283, "0");
+                writeGroup(360, toHandle(imageObjects.firstReactorHandle + entity.index));
+                writeGroup(71, "1");
+                writeGroup(91, "2");
+                writeGroup(14, "-0.5");
+                writeGroup(24, "-0.5");
+                appendGroup(out, 14, image.pixelWidth - 0.5);
+                appendGroup(out, 24, image.pixelHeight - 0.5);
+            } else {
+                // Text blocks are stacked 3 units apart
+                double textY = 3.0 * entity.index;
+                writeGroup(0, "TEXT");
+                writeGroup(5, handle);
+                writeGroup(330, "1F");
+                writeGroup(100, "AcDbEntity");
+                writeGroup(8, "0");
+                writeGroup(100, "AcDbText");
+                writeGroup(10, "0.0");
+                appendGroup(out, 20, textY);
+                writeGroup(30, "0.0");
+                writeGroup(40, "2.5");
+                writeGroup(1, texts[entity.index]);
+                writeGroup(50, "0.0");
+                writeGroup(41, "1.0");
+                writeGroup(7, "STANDARD");
+                writeGroup(71, "0");
+                writeGroup(72, "0");
+                writeGroup(73, "0");
+                writeGroup(100, "AcDbText");
+            }
+        }
+    }
+
+    unsigned resolveWriterThreads(size_t chunkCount) const {
+        unsigned threads = options.writerThreads;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return static_cast<unsigned>(std::min<size_t>(threads, chunkCount));
+    }
+
+    // Formats chunks on worker threads and writes them strictly in order. At
+    // most `window` chunks are buffered at a time.
+    bool writeEntities(OutputSink& sink, const std::vector<EntityRef>& entities,
+                       unsigned long long firstHandle) {
+        const size_t chunkSize = std::max<size_t>(1, options.entitiesPerChunk);
+        const size_t chunkCount = (entities.size() + chunkSize - 1) / chunkSize;
+        const unsigned threads = resolveWriterThreads(chunkCount);
+
+        if (threads <= 1) {
+            std::string buffer;
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                buffer.clear();
+                size_t begin = chunk * chunkSize;
+                formatEntities(entities, begin, std::min(begin + chunkSize, entities.size()),
+                    firstHandle, buffer);
+                if (!sink.write(buffer.data(), buffer.size())) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        log("Formatting %zu entities in %zu chunks on %u threads",
+            entities.size(), chunkCount, threads);
+
+        const size_t window = static_cast<size_t>(threads) * 2;
+        std::vector<std::string> buffers(window);
+        std::vector<char> ready(window, 0);
+        std::mutex mutex;
+        std::condition_variable chunkDone;
+        std::condition_variable slotFree;
+        size_t nextChunk = 0;
+        size_t written = 0;
+        bool failed = false;
+
+        auto worker = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                slotFree.wait(lock, [&] {
+                    return failed || nextChunk >= chunkCount || nextChunk < written + window;
+                });
+                if (failed || nextChunk >= chunkCount) {
+                    return;
+                }
+                size_t chunk = nextChunk++;
+                size_t slot = chunk % window;
+                std::string buffer = std::move(buffers[slot]);
+                lock.unlock();
+
+                buffer.clear();
+                size_t begin = chunk * chunkSize;
+                formatEntities(entities, begin, std::min(begin + chunkSize, entities.size()),
+                    firstHandle, buffer);
+
+                lock.lock();
+                buffers[slot] = std::move(buffer);
+                ready[slot] = 1;
+                chunkDone.notify_all();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back(worker);
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (written < chunkCount && !failed) {
+                size_t slot = written % window;
+                chunkDone.wait(lock, [&] { return ready[slot] != 0; });
+                std::string buffer = std::move(buffers[slot]);
+                lock.unlock();
+
+                bool ok = sink.write(buffer.data(), buffer.size());
+
+                lock.lock();
+                buffers[slot] = std::move(buffer);  // Keep the capacity for reuse
+                ready[slot] = 0;
+                ++written;
+                failed = !ok;
+                slotFree.notify_all();
+            }
+        }
+
+        for (auto& thread : workers) {
+            thread.join();
+        }
+        return !failed;
+    }
+
+    // Works out the IMAGEDEF set and the handles of all image objects
+    void planImageObjects(const std::string& outputPath, unsigned long long firstEntityHandle) {
+        imageObjects = ImageObjects();
+        imageObjects.firstImageHandle = firstEntityHandle;
+        if (images.empty()) {
+            return;
+        }
+
+        // CAD applications resolve image paths relative to the drawing
+        std::filesystem::path outputDir;
+        if (!outputPath.empty()) {
+            outputDir = std::filesystem::absolute(outputPath).parent_path();
+        }
+        std::map<std::string, size_t> defIndex;
+        for (const auto& image : images) {
+            auto found = defIndex.find(image.path);
+            if (found == defIndex.end()) {
+                std::error_code ec;
+                std::filesystem::path relative;
+                if (!outputDir.empty()) {
+                    relative = std::filesystem::relative(std::filesystem::absolute(image.path), outputDir, ec);
+                }
+                found = defIndex.emplace(image.path, imageObjects.defPaths.size()).first;
+                imageObjects.defPaths.push_back(ec || relative.empty() ? image.path : relative.string());
+            }
+            imageObjects.defOfImage.push_back(found->second);
+        }
+
+        imageObjects.dictHandle = nextHandle++;
+        imageObjects.firstDefHandle = nextHandle;
+        nextHandle += imageObjects.defPaths.size();
+        imageObjects.firstReactorHandle = nextHandle;
+        nextHandle += images.size();
+    }
+
+    void formatImageObjects(std::string& out) const {
+        auto writeGroup = [&out](int code, const std::string& value) {
+            appendGroup(out, code, value);
+        };
+        std::string dictHandle = toHandle(imageObjects.dictHandle);
+
+        writeGroup(0, "DICTIONARY");
+        writeGroup(5, dictHandle);
+        writeGroup(330, "C");
+        writeGroup(100, "AcDbDictionary");
+        writeGroup(281, "1");
+        for (size_t d = 0; d < imageObjects.defPaths.size(); ++d) {
+            writeGroup(3, "IMAGE_" + std::to_string(d + 1));
+            writeGroup(350, toHandle(imageObjects.firstDefHandle + d));
+        }
+
+        for (size_t d = 0; d < imageObjects.defPaths.size(); ++d) {
+            writeGroup(0, "IMAGEDEF");
+            writeGroup(5, toHandle(imageObjects.firstDefHandle + d));
+            writeGroup(102, "{ACAD_REACTORS");
+            writeGroup(330, dictHandle);
+            for (size_t i = 0; i < images.size(); ++i) {
+                if (imageObjects.defOfImage[i] == d) {
+                    writeGroup(330, toHandle(imageObjects.firstReactorHandle + i));
+                }
+            }
+            writeGroup(102, "}");
+            writeGroup(330, dictHandle);
+            writeGroup(100, "AcDbRasterImageDef");
+            writeGroup(90, "0");
+            writeGroup(1, imageObjects.defPaths[d]);
+            size_t first = std::find(imageObjects.defOfImage.begin(), imageObjects.defOfImage.end(), d) -
+                imageObjects.defOfImage.begin();
+            appendGroup(out, 10, static_cast<double>(images[first].pixelWidth));
+            appendGroup(out, 20, static_cast<double>(images[first].pixelHeight));
+            writeGroup(11, "1.0");
+            writeGroup(21, "1.0");
+            writeGroup(280, "1");
+            writeGroup(281, "0");
+        }
+
+        for (size_t i = 0; i < images.size(); ++i) {
+            std::string imageHandle = toHandle(imageObjects.firstImageHandle + i);
+            writeGroup(0, "IMAGEDEF_REACTOR");
+            writeGroup(5, toHandle(imageObjects.firstReactorHandle + i));
+            writeGroup(330, imageHandle);
+            writeGroup(100, "AcDbRasterImageDefReactor");
+            writeGroup(90, "2");
+            writeGroup(330, imageHandle);
+        }
+    }
+
+    std::string formatObjects() {
+        std::string out;
+        auto writeGroup = [&out](int code, const std::string& value) {
+            appendGroup(out, code, value);
+        };
 
         // Write OBJECTS section (required for AC1032)
         writeGroup(0, "SECTION");
@@ -326,6 +796,10 @@ public:
         writeGroup(350, "D");
         writeGroup(3, "ACAD_MLINESTYLE");
         writeGroup(350, "17");
+        if (!images.empty()) {
+            writeGroup(3, "ACAD_IMAGE_DICT");
+            writeGroup(350, toHandle(imageObjects.dictHandle));
+        }
 
         // Empty group dictionary
         writeGroup(0, "DICTIONARY");
@@ -362,15 +836,212 @@ public:
         writeGroup(62, "256");
         writeGroup(6, "BYLAYER");
 
+        if (!images.empty()) {
+            formatImageObjects(out);
+        }
+
         writeGroup(0, "ENDSEC");
 
         // Write EOF
         writeGroup(0, "EOF");
 
-        log("DXF file written successfully");
+        return out;
+    }
+
+    bool writeDXF(const std::string& outputPath) {
+        log("Attempting to write DXF file: %s", outputPath.c_str());
+        std::unique_ptr<OutputSink> sink = OutputSink::open(outputPath, options.output);
+        return sink && writeDXF(*sink, outputPath);
+    }
+
+    // `outputPath` is only where image paths are made relative to; empty
+    // leaves them as they are
+    bool writeDXF(OutputSink& sink, const std::string& outputPath) {
+
+        // Handles are assigned up front: tables and blocks first, then one
+        // contiguous range for the entities, so $HANDSEED is known before
+        // anything is written
+        symbols = SymbolInstancer::Result();
+        if (options.instanceSymbols) {
+            symbols = SymbolInstancer(options.symbolOptions).detect(vectors);
+            log("Symbol instancing: %zu blocks, %zu inserts replacing %zu line segments",
+                symbols.blocks.size(), symbols.inserts.size(), symbols.instancedSegments);
+        }
+
+        nextHandle = 100;
+        std::string tablesAndBlocks = formatTablesAndBlocks();
+        std::vector<EntityRef> entities = collectEntities();
+        unsigned long long firstEntityHandle = nextHandle;
+        nextHandle += entities.size();
+        planImageObjects(outputPath, firstEntityHandle);
+
+        log("Writing %zu entities (%zu images, %zu vector elements, %zu inserts, %zu text elements)...",
+            entities.size(), images.size(), vectors.size() - symbols.instancedSegments,
+            symbols.inserts.size(), texts.size());
+        return assembleDXF(sink, computeExtents(), tablesAndBlocks, "", entities, 0, firstEntityHandle);
+    }
+
+    // Writes the file around the entities: header, tables and blocks, the
+    // first `spoolAfter` of `entities`, the spooled entities if any, the rest
+    // of `entities`, then the objects
+    bool assembleDXF(OutputSink& sink, const geometry::Extents& extents,
+                     const std::string& tablesAndBlocks, const std::string& spoolPath,
+                     const std::vector<EntityRef>& entities, size_t spoolAfter,
+                     unsigned long long firstEntityHandle) {
+        log("Drawing extents: (%.2f,%.2f) - (%.2f,%.2f)",
+            extents.minX, extents.minY, extents.maxX, extents.maxY);
+
+        log("Writing DXF header...");
+        std::string header = formatHeader(extents, toHandle(nextHandle));
+        if (!sink.write(header.data(), header.size()) ||
+            !sink.write(tablesAndBlocks.data(), tablesAndBlocks.size())) {
+            log("Failed while writing DXF header");
+            return false;
+        }
+
+        log("Writing entities section...");
+        std::string section;
+        appendGroup(section, 0, "SECTION");
+        appendGroup(section, 2, "ENTITIES");
+        if (!sink.write(section.data(), section.size())) {
+            log("Failed while writing entities");
+            return false;
+        }
+
+        std::vector<EntityRef> before(entities.begin(), entities.begin() + spoolAfter);
+        if (!writeEntities(sink, before, firstEntityHandle)) {
+            log("Failed while writing entities");
+            return false;
+        }
+
+        if (!spoolPath.empty()) {
+            FILE* spooled = fopen(spoolPath.c_str(), "rb");
+            if (!spooled) {
+                log("Failed to reopen entity spool %s", spoolPath.c_str());
+                return false;
+            }
+            std::vector<char> buffer(1 << 20);
+            bool ok = true;
+            for (size_t n; ok && (n = fread(buffer.data(), 1, buffer.size(), spooled)) > 0;) {
+                ok = sink.write(buffer.data(), n);
+            }
+            ok = ok && !ferror(spooled);
+            fclose(spooled);
+            if (!ok) {
+                log("Failed while copying spooled entities");
+                return false;
+            }
+        }
+
+        std::vector<EntityRef> after(entities.begin() + spoolAfter, entities.end());
+        if (!writeEntities(sink, after, firstEntityHandle + spoolAfter)) {
+            log("Failed while writing entities");
+            return false;
+        }
+
+        section.clear();
+        appendGroup(section, 0, "ENDSEC");
+        section += formatObjects();
+        if (!sink.write(section.data(), section.size())) {
+            log("Failed while writing objects");
+            return false;
+        }
+
+        if (!sink.finish()) {
+            log("Failed to write DXF file");
+            return false;
+        }
+        const OutputSink::Stats& written = sink.getStats();
+        log("DXF file written successfully (%llu bytes, %llu stored)",
+            static_cast<unsigned long long>(written.bytesIn),
+            static_cast<unsigned long long>(written.bytesOut));
         return true;
     }
 
+    bool beginStream(const std::string& outputPath) {
+        // Scratch copy of the LINE section; only the final file is compressed
+        spool.outputPath = outputPath;
+        spool.path = outputPath + ".spool";
+        spool.extents = geometry::Extents();
+        OutputSink::Options plain;
+        plain.compression = OutputSink::Compression::None;
+        spool.sink = OutputSink::open(spool.path, plain);
+        if (!spool.sink) {
+            return false;
+        }
+
+        // Tables and blocks take the same handles again in finishStream()
+        symbols = SymbolInstancer::Result();
+        nextHandle = 100;
+        formatTablesAndBlocks();
+        spool.firstHandle = spool.nextHandle = nextHandle;
+        log("Streaming DXF entities to %s", spool.path.c_str());
+        return true;
+    }
+
+    bool streamVectors(const std::vector<PDFProcessor::VectorElement>& pageVectors) {
+        if (!spool.sink) {
+            log("Cannot stream vectors: no stream started");
+            return false;
+        }
+        spool.buffer.clear();
+        for (const auto& vec : pageVectors) {
+            geometry::accumulateExtents(vec.points.data(), vec.points.size() / 2, spool.extents);
+            if (vec.type == PDFProcessor::VectorElement::Type::LINE) {
+                appendLine(spool.buffer, vec, toHandle(spool.nextHandle++));
+            }
+        }
+        return spool.sink->write(spool.buffer.data(), spool.buffer.size());
+    }
+
+    bool finishStream() {
+        if (!spool.sink) {
+            log("Cannot finish stream: no stream started");
+            return false;
+        }
+        bool ok = spool.sink->finish();
+        spool.sink.reset();
+        if (!ok) {
+            log("Failed to write entity spool %s", spool.path.c_str());
+        } else {
+            // Images go ahead of the streamed lines so vectors draw on top of
+            // them, as in collectEntities(). Their handles follow the lines',
+            // which were numbered as they streamed.
+            nextHandle = 100;
+            std::string tablesAndBlocks = formatTablesAndBlocks();
+            std::vector<EntityRef> entities;
+            for (size_t i = 0; i < images.size(); ++i) {
+                entities.push_back({EntityRef::Kind::Image, i});
+            }
+            for (size_t i = 0; i < texts.size(); ++i) {
+                entities.push_back({EntityRef::Kind::Text, i});
+            }
+            unsigned long long firstEntityHandle = spool.nextHandle;
+            nextHandle = firstEntityHandle + entities.size();
+            planImageObjects(spool.outputPath, firstEntityHandle);
+
+            log("Writing %llu streamed lines, %zu images and %zu text elements...",
+                spool.nextHandle - spool.firstHandle, images.size(), texts.size());
+            std::unique_ptr<OutputSink> sink = OutputSink::open(spool.outputPath, options.output);
+            ok = sink && assembleDXF(*sink, computeExtents(spool.extents), tablesAndBlocks,
+                spool.path, entities, images.size(), firstEntityHandle);
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(spool.path, ec);
+        return ok;
+    }
+
+    void cancelStream() {
+        if (!spool.sink) {
+            return;
+        }
+        spool.sink.reset();
+        std::error_code ec;
+        std::filesystem::remove(spool.path, ec);
+        log("Streamed DXF output cancelled");
+    }
+
     bool writeDWG(const std::string& outputPath) {
         log("DWG format not yet implemented");
         return false;
@@ -380,6 +1051,14 @@ public:
 CADGenerator::CADGenerator() : pimpl(std::make_unique<Impl>()) {}
 CADGenerator::~CADGenerator() = default;
 
+void CADGenerator::setOptions(const Options& options) {
+    pimpl->options = options;
+}
+
+const CADGenerator::Options& CADGenerator::getOptions() const {
+    return pimpl->options;
+}
+
 bool CADGenerator::generateCAD(const std::vector<PDFProcessor::VectorElement>& vectors,
                              const std::vector<std::string>& texts,
                              const std::string& outputPath) {
@@ -393,6 +1072,15 @@ bool CADGenerator::generateCAD(const std::vector<PDFProcessor::VectorElement>& v
     return pimpl->writeDXF(outputPath);
 }
 
+bool CADGenerator::generateCAD(const std::vector<PDFProcessor::VectorElement>& vectors,
+                               const std::vector<std::string>& texts,
+                               OutputSink& sink) {
+    log("Generating CAD data with %zu vectors and %zu text elements", vectors.size(), texts.size());
+    pimpl->vectors = vectors;
+    pimpl->texts = texts;
+    return pimpl->writeDXF(sink, "");
+}
+
 bool CADGenerator::setVectorElements(const std::vector<PDFProcessor::VectorElement>& elements) {
     log("Setting %d vector elements", elements.size());
     pimpl->vectors = elements;
@@ -405,6 +1093,98 @@ bool CADGenerator::setTextElements(const std::vector<std::string>& texts) {
     return true;
 }
 
+bool CADGenerator::setImageElements(const std::vector<PDFProcessor::ImageElement>& images) {
+    log("Setting %zu image elements", images.size());
+    pimpl->images = images;
+    return true;
+}
+
+bool CADGenerator::importModel(const std::string& path, int firstPage, int pageCount) {
+    DocumentModelReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    const pdf2cad::model::DocumentHeader& header = reader.getHeader();
+    log("Importing document model %s (%u pages, from %s)", path.c_str(),
+        header.page_count(), header.metadata().source_path().c_str());
+
+    std::vector<PDFProcessor::VectorElement> vectors;
+    std::vector<std::string> texts;
+    std::vector<PDFProcessor::ImageElement> images;
+    pdf2cad::model::Page page;
+    int lastPage = pageCount < 0 ? static_cast<int>(header.page_count()) : firstPage + pageCount;
+    // Before version 2 the thickness field was not a measured stroke width
+    const bool hasStrokeWidths = header.format_version() >= 2;
+
+    for (int i = 0; i < lastPage && i < static_cast<int>(header.page_count()); ++i) {
+        if (i < firstPage) {
+            if (!reader.skipPage()) {
+                log("Model file ends before page %d", i + 1);
+                return false;
+            }
+            continue;
+        }
+        if (!reader.readPage(page)) {
+            log("Failed to read page %d from model file", i + 1);
+            return false;
+        }
+
+        for (const auto& entity : page.entities()) {
+            if (entity.points_size() != 4) {
+                log("Skipping entity with %d coordinates on page %d", entity.points_size(), i + 1);
+                continue;
+            }
+            PDFProcessor::VectorElement element;
+            element.type = static_cast<PDFProcessor::VectorElement::Type>(entity.type());
+            std::copy(entity.points().begin(), entity.points().end(), element.points.begin());
+            element.thickness = hasStrokeWidths ? entity.thickness() : 0.0;
+            element.page = static_cast<int>(page.index());
+            vectors.push_back(std::move(element));
+        }
+        for (const auto& text : page.texts()) {
+            texts.push_back(text.text());
+        }
+        for (const auto& image : page.images()) {
+            PDFProcessor::ImageElement element;
+            element.path = image.path();
+            element.pixelWidth = image.pixel_width();
+            element.pixelHeight = image.pixel_height();
+            element.x = image.x();
+            element.y = image.y();
+            element.uX = image.u_x();
+            element.uY = image.u_y();
+            element.vX = image.v_x();
+            element.vY = image.v_y();
+            element.page = static_cast<int>(page.index());
+            images.push_back(element);
+        }
+    }
+
+    log("Imported %zu vector elements, %zu text elements and %zu images",
+        vectors.size(), texts.size(), images.size());
+    pimpl->vectors = std::move(vectors);
+    pimpl->texts = std::move(texts);
+    pimpl->images = std::move(images);
+    return true;
+}
+
+bool CADGenerator::beginStream(const std::string& outputPath) {
+    log("Starting streamed DXF output: %s", outputPath.c_str());
+    return pimpl->beginStream(outputPath);
+}
+
+bool CADGenerator::streamVectors(const std::vector<PDFProcessor::VectorElement>& vectors) {
+    return pimpl->streamVectors(vectors);
+}
+
+bool CADGenerator::finishStream() {
+    return pimpl->finishStream();
+}
+
+void CADGenerator::cancelStream() {
+    pimpl->cancelStream();
+}
+
 bool CADGenerator::generateCAD(const std::string& outputPath, Format format) {
     log("Generating CAD file in %s format", format == Format::DXF ? "DXF" : "DWG");
     switch (format) {
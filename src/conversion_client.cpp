@@ -0,0 +1,70 @@
+#include "conversion_client.hpp"
+#include "local_socket.hpp"
+#include <fstream>
+#include <iterator>
+
+bool requestConversion(const std::string& socketPath,
+                       const ConversionRequest& request,
+                       ConversionReply& reply,
+                       const std::function<void(const std::string&)>& onStatus) {
+    reply = ConversionReply();
+
+    std::string upload;
+    if (request.uploadInput) {
+        std::ifstream file(request.inputPath, std::ios::binary);
+        if (!file) {
+            reply.error = "cannot read " + request.inputPath;
+            return false;
+        }
+        upload.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    LocalSocket socket;
+    if (!socket.connect(socketPath)) {
+        reply.error = "cannot connect to " + socketPath;
+        return false;
+    }
+
+    std::string header;
+    if (request.uploadInput) {
+        header += "input-size " + std::to_string(upload.size()) + "\n";
+    } else {
+        header += "input " + request.inputPath + "\n";
+    }
+    if (!request.outputPath.empty()) {
+        header += "output " + request.outputPath + "\n";
+    }
+    for (const auto& option : request.options) {
+        header += option.first + " " + option.second + "\n";
+    }
+    header += "\n";
+
+    if (!socket.sendAll(header) || !socket.sendAll(upload)) {
+        reply.error = "failed to send request";
+        return false;
+    }
+
+    std::string line;
+    while (socket.readLine(line)) {
+        if (line.compare(0, 7, "status ") == 0) {
+            if (onStatus) {
+                onStatus(line.substr(7));
+            }
+        } else if (line.compare(0, 3, "ok ") == 0) {
+            size_t size = static_cast<size_t>(std::stoull(line.substr(3)));
+            reply.output.resize(size);
+            if (size > 0 && !socket.recvAll(&reply.output[0], size)) {
+                reply.error = "connection lost while receiving output";
+                return false;
+            }
+            reply.ok = true;
+            return true;
+        } else if (line.compare(0, 6, "error ") == 0) {
+            reply.error = line.substr(6);
+            return false;
+        }
+    }
+
+    reply.error = "connection closed by server";
+    return false;
+}
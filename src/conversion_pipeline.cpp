@@ -0,0 +1,296 @@
+#include "conversion_pipeline.hpp"
+#include "geometry_kernels.hpp"
+#include "page_arena.hpp"
+#include "log.hpp"
+#include "poppler-document.h"
+#include "poppler-page.h"
+#include "poppler-page-renderer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <mutex>
+
+namespace {
+
+struct RenderedPage {
+    int index = -1;
+    cv::Mat gray;               // Empty when the page failed to render
+    double heightPoints = 0.0;
+    double renderSeconds = 0.0;  // Counts against the page's time budget
+    std::string text;
+};
+
+struct TracedPage {
+    int index = -1;
+    std::vector<PDFProcessor::VectorElement> vectors;
+    std::vector<PDFProcessor::ImageElement> rasters;  // Pages that fell back to an image
+    PDFProcessor::PageReport report;
+    std::string text;
+};
+
+// Vectorizer and arena for one page at a time. Vectorize workers take one
+// per page, so each set is only ever used by a single thread at once.
+struct TraceScratch {
+    std::unique_ptr<RasterVectorizer> vectorizer;
+    PageArena arena;
+};
+
+class ScratchPool {
+public:
+    explicit ScratchPool(const PDFProcessor::Options& options) : options(options) {}
+
+    std::unique_ptr<TraceScratch> take() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty()) {
+                std::unique_ptr<TraceScratch> scratch = std::move(idle.back());
+                idle.pop_back();
+                return scratch;
+            }
+        }
+        auto scratch = std::make_unique<TraceScratch>();
+        scratch->vectorizer = RasterVectorizer::create(options.vectorizer, options.vectorizerOptions);
+        return scratch;
+    }
+
+    void give(std::unique_ptr<TraceScratch> scratch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(std::move(scratch));
+    }
+
+private:
+    const PDFProcessor::Options& options;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceScratch>> idle;
+};
+
+// Pages taken for rendering stay within `size` of the next page to write.
+// Without it one slow page lets the others finish and pile up in the
+// writer's reorder buffer for as long as it takes.
+class PageWindow {
+public:
+    explicit PageWindow(int size) : size(std::max(1, size)) {}
+
+    // Blocks until `page` is inside the window; false once cancelled
+    bool admit(int page) {
+        std::unique_lock<std::mutex> lock(mutex);
+        moved.wait(lock, [&] { return cancelled || page < nextToWrite + size; });
+        return !cancelled;
+    }
+
+    void advance(int next) {
+        std::lock_guard<std::mutex> lock(mutex);
+        nextToWrite = next;
+        moved.notify_all();
+    }
+
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        moved.notify_all();
+    }
+
+private:
+    const int size;
+    std::mutex mutex;
+    std::condition_variable moved;
+    int nextToWrite = 0;
+    bool cancelled = false;
+};
+
+} // namespace
+
+ConversionPipeline::ConversionPipeline(PDFProcessor& processor, CADGenerator& generator)
+    : processor(processor), generator(generator) {}
+
+void ConversionPipeline::setOptions(const Options& options) {
+    this->options = options;
+}
+
+const ConversionPipeline::Options& ConversionPipeline::getOptions() const {
+    return options;
+}
+
+const std::vector<Pipeline::StageStats>& ConversionPipeline::getStats() const {
+    return stats;
+}
+
+const std::vector<PDFProcessor::PageReport>& ConversionPipeline::getPageReports() const {
+    return pageReports;
+}
+
+bool ConversionPipeline::convert(const std::string& inputPath, const std::string& outputPath) {
+    stats.clear();
+    pageReports.clear();
+    if (!processor.loadPDF(inputPath)) {
+        return false;
+    }
+    PDFProcessor::Options pdfOptions = processor.getOptions();
+    // Computed up front: the image thread and the vectorize workers only read them
+    const std::vector<double>& pageOffsets = processor.getPageOffsets();
+    const int pageCount = static_cast<int>(pageOffsets.size());
+
+    if (!generator.beginStream(outputPath)) {
+        log("Failed to start DXF output: %s", outputPath.c_str());
+        return false;
+    }
+
+    unsigned vectorizeWorkers = options.vectorizeWorkers;
+    if (vectorizeWorkers == 0) {
+        vectorizeWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (pdfOptions.vectorizerOptions.threads == 0) {
+        // Pages already run side by side; share the cores rather than oversubscribe
+        pdfOptions.vectorizerOptions.threads =
+            std::max(1u, std::thread::hardware_concurrency() / vectorizeWorkers);
+    }
+    // Enough pages to keep every worker and queue busy while pages arrive in order
+    const int windowSize = static_cast<int>(
+        options.renderWorkers + vectorizeWorkers + 2 * options.queueCapacity + 1);
+    log("Pipelined conversion of %d pages: %u render, %u vectorize workers, queues of %zu pages, "
+        "at most %d pages in flight, %s vectorizer",
+        pageCount, options.renderWorkers, vectorizeWorkers, options.queueCapacity, windowSize,
+        RasterVectorizer::backendName(pdfOptions.vectorizer));
+
+    // Images have their own reader and output, so they run beside the pipeline
+    std::future<bool> images = std::async(std::launch::async, [this] {
+        return processor.extractImages();
+    });
+
+    BoundedQueue<RenderedPage> rendered(options.queueCapacity);
+    BoundedQueue<TracedPage> traced(options.queueCapacity);
+    Pipeline pipeline;
+    PageWindow window(windowSize);
+    pipeline.onAbort([&window] { window.cancel(); });
+
+    std::atomic<int> nextPage{0};
+    pipeline.addSource<RenderedPage>("render", options.renderWorkers, rendered,
+        [&](const std::function<bool(RenderedPage)>& emit) {
+            // Poppler documents are not shared between threads
+            std::unique_ptr<poppler::document> doc(poppler::document::load_from_file(inputPath));
+            if (!doc) {
+                log("Render worker failed to open %s", inputPath.c_str());
+                return false;
+            }
+            poppler::page_renderer renderer;
+            PDFProcessor::setRenderHints(renderer);
+
+            for (int i = nextPage++; i < pageCount; i = nextPage++) {
+                if (!window.admit(i)) {
+                    return false;
+                }
+                RenderedPage out;
+                out.index = i;
+                std::unique_ptr<poppler::page> page(doc->create_page(i));
+                if (page) {
+                    out.heightPoints = page->page_rect().height();
+                    auto renderStart = std::chrono::steady_clock::now();
+                    if (!PDFProcessor::renderPageGray(renderer, *page, pdfOptions.renderScale, out.gray)) {
+                        log("Failed to render page %d", i + 1);
+                    }
+                    out.renderSeconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - renderStart).count();
+                    out.text = PDFProcessor::pageText(*page);
+                } else {
+                    log("Warning: Failed to create page %d", i + 1);
+                }
+                // Failed pages still flow through so the writer's order is kept
+                if (!emit(std::move(out))) {
+                    return false;
+                }
+            }
+            return true;
+        });
+
+    ScratchPool scratchPool(pdfOptions);
+    pipeline.addStage<RenderedPage, TracedPage>("vectorize", vectorizeWorkers, rendered, traced,
+        [&](RenderedPage& page, const std::function<bool(TracedPage)>& emit) {
+            TracedPage out;
+            out.index = page.index;
+            out.text = std::move(page.text);
+            out.report.page = page.index;
+            out.report.outcome = PDFProcessor::PageReport::Outcome::Failed;
+            if (!page.gray.empty()) {
+                std::unique_ptr<TraceScratch> scratch = scratchPool.take();
+                geometry::Extents pageExtents;
+                out.report = PDFProcessor::tracePage(page.gray, page.index, page.heightPoints,
+                    pageOffsets[page.index], page.renderSeconds, pdfOptions,
+                    *scratch->vectorizer, scratch->arena, out.vectors, out.rasters, pageExtents);
+                scratchPool.give(std::move(scratch));
+            }
+            // The rendered pixels are the biggest thing in flight; drop them now
+            page.gray.release();
+            return emit(std::move(out));
+        });
+
+    // Pages finish out of order with several vectorize workers; hold the
+    // early ones back so the DXF lists pages in order. The window keeps this
+    // to fewer than windowSize pages.
+    std::map<int, TracedPage> pending;
+    int nextToWrite = 0;
+    size_t lineCount = 0;
+    std::vector<std::string> texts;
+    std::vector<PDFProcessor::ImageElement> rasters;
+    pipeline.addSink<TracedPage>("write", 1, traced,
+        [&](TracedPage& page) {
+            pending.emplace(page.index, std::move(page));
+            for (auto it = pending.find(nextToWrite); it != pending.end(); it = pending.find(nextToWrite)) {
+                if (!generator.streamVectors(it->second.vectors)) {
+                    log("Failed to write page %d", nextToWrite + 1);
+                    return false;
+                }
+                lineCount += it->second.vectors.size();
+                rasters.insert(rasters.end(), it->second.rasters.begin(), it->second.rasters.end());
+                pageReports.push_back(it->second.report);
+                if (!it->second.text.empty()) {
+                    texts.push_back(std::move(it->second.text));
+                }
+                log("Wrote page %d: %zu vector elements", nextToWrite + 1, it->second.vectors.size());
+                pending.erase(it);
+                window.advance(++nextToWrite);
+            }
+            return true;
+        });
+
+    bool ok = pipeline.run();
+    bool imagesOk = images.get();
+    stats = pipeline.getStats();
+
+    log("Pipeline finished in %.2f s", pipeline.getWallSeconds());
+    for (const Pipeline::StageStats& stage : stats) {
+        log("  %-9s %2u workers %5zu pages  occupancy %5.1f%%  busy %.2f s  starved %.2f s  blocked %.2f s",
+            stage.name.c_str(), stage.workers, stage.items, 100.0 * stage.occupancy,
+            stage.busySeconds, stage.starvedSeconds, stage.blockedSeconds);
+        if (stage.queueCapacity > 0) {
+            log("            output queue high water %zu of %zu", stage.queueHighWater, stage.queueCapacity);
+        }
+    }
+
+    if (!ok || nextToWrite != pageCount) {
+        log("Pipelined conversion failed after %d of %d pages", nextToWrite, pageCount);
+        generator.cancelStream();
+        return false;
+    }
+    if (!imagesOk) {
+        log("Failed to extract image elements");
+        generator.cancelStream();
+        return false;
+    }
+
+    log("Traced %zu vector elements and %zu text elements", lineCount, texts.size());
+    size_t degraded = std::count_if(pageReports.begin(), pageReports.end(),
+        [](const PDFProcessor::PageReport& report) {
+            return report.outcome != PDFProcessor::PageReport::Outcome::Full;
+        });
+    if (degraded > 0) {
+        log("%zu of %zu pages exceeded their budget and were degraded", degraded, pageReports.size());
+    }
+    // Page rasters come first, so embedded images are drawn on top of them
+    rasters.insert(rasters.end(), processor.getImageElements().begin(), processor.getImageElements().end());
+    generator.setTextElements(texts);
+    generator.setImageElements(rasters);
+    return generator.finishStream();
+}
@@ -0,0 +1,415 @@
+#include "conversion_server.hpp"
+#include "local_socket.hpp"
+#include "pdf_processor.hpp"
+#include "cad_generator.hpp"
+#include "log.hpp"
+#include "poppler-document.h"
+#include "poppler-page.h"
+#include "poppler-page-renderer.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// One-page PDF with a single stroked line, converted once at startup so the
+// first real job doesn't pay for font, renderer and OpenCV initialization
+const char kWarmUpPDF[] =
+    "%PDF-1.4\n"
+    "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n"
+    "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n"
+    "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 72 72] /Contents 4 0 R >>\nendobj\n"
+    "4 0 obj\n<< /Length 17 >>\nstream\n10 10 m 62 62 l S\nendstream\nendobj\n"
+    "xref\n0 5\n"
+    "0000000000 65535 f \n"
+    "0000000009 00000 n \n"
+    "0000000058 00000 n \n"
+    "0000000115 00000 n \n"
+    "0000000200 00000 n \n"
+    "trailer\n<< /Size 5 /Root 1 0 R >>\nstartxref\n267\n%%EOF\n";
+
+} // namespace
+
+class ConversionServer::Impl {
+public:
+    Config config;
+    LocalSocket listener;
+    std::vector<std::thread> workers;
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<LocalSocket> pendingJobs;
+    std::atomic<bool> stopping{false};
+    std::atomic<unsigned long long> nextJobId{1};
+
+    void warmUp() {
+        log("Warming up Poppler and OpenCV...");
+        std::unique_ptr<poppler::document> doc(poppler::document::load_from_raw_data(
+            kWarmUpPDF, static_cast<int>(sizeof(kWarmUpPDF) - 1)));
+        if (!doc) {
+            log("Warning: warm-up document failed to load");
+            return;
+        }
+        std::unique_ptr<poppler::page> page(doc->create_page(0));
+        poppler::page_renderer renderer;
+        poppler::image img = renderer.render_page(page.get(), 72.0, 72.0);
+        if (!img.is_valid()) {
+            log("Warning: warm-up render failed");
+            return;
+        }
+
+        cv::Mat image(img.height(), img.width(), CV_8UC4,
+            const_cast<char*>(img.const_data()));
+        cv::Mat gray;
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+        RasterPaths paths;
+        RasterVectorizer::create(RasterVectorizer::Backend::Contours, RasterVectorizer::Options())
+            ->vectorize(gray, paths);
+        log("Warm-up complete");
+    }
+
+    void workerLoop() {
+        for (;;) {
+            LocalSocket client;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return stopping || !pendingJobs.empty(); });
+                if (stopping) {
+                    return;
+                }
+                client = std::move(pendingJobs.front());
+                pendingJobs.pop_front();
+            }
+
+            unsigned long long jobId = nextJobId++;
+            // A failing job must never take the worker down with it
+            try {
+                handleJob(client, jobId);
+            } catch (const std::exception& e) {
+                log("Job %llu: exception: %s", jobId, e.what());
+                client.sendAll(std::string("error ") + e.what() + "\n");
+            } catch (...) {
+                log("Job %llu: unknown exception", jobId);
+                client.sendAll("error unknown exception\n");
+            }
+        }
+    }
+
+    // Resolves a path sent by a client. Fails when path mode is off or the
+    // path leads outside the root, also by way of symlinks or "..".
+    bool confinePath(const std::string& requested, std::string& resolved) const {
+        if (config.pathRoot.empty() || requested.empty()) {
+            return false;
+        }
+        std::error_code error;
+        std::filesystem::path root = std::filesystem::weakly_canonical(config.pathRoot, error);
+        if (error) {
+            return false;
+        }
+        std::filesystem::path path = requested;
+        if (path.is_relative()) {
+            path = root / path;
+        }
+        path = std::filesystem::weakly_canonical(path, error);
+        if (error) {
+            return false;
+        }
+        std::filesystem::path relative = path.lexically_relative(root);
+        if (relative.empty() || relative == "." || *relative.begin() == "..") {
+            return false;
+        }
+        resolved = path.string();
+        return true;
+    }
+
+    bool applyOption(PDFProcessor::Options& options, const std::string& key, const std::string& value) {
+        try {
+            if (key == "render-scale") {
+                options.renderScale = std::stod(value);
+                return options.renderScale > 0.0;
+            }
+            if (key == "quantization-grid") {
+                options.quantizationGrid = std::stod(value);
+                return true;
+            }
+            if (key == "page-gap") {
+                options.pageGap = std::stod(value);
+                return true;
+            }
+            if (key == "page-seconds") {
+                options.budget.maxSeconds = std::stod(value);
+                return true;
+            }
+            if (key == "page-max-paths") {
+                options.budget.maxPaths = std::stoull(value);
+                return true;
+            }
+            if (key == "page-max-entities") {
+                options.budget.maxEntities = std::stoull(value);
+                return true;
+            }
+            if (key == "vectorizer") {
+                if (value == "contours") {
+                    options.vectorizer = RasterVectorizer::Backend::Contours;
+                    return true;
+                }
+                if (value == "segments") {
+                    options.vectorizer = RasterVectorizer::Backend::Segments;
+                    return true;
+                }
+                if (value == "centerline") {
+                    options.vectorizer = RasterVectorizer::Backend::Centerline;
+                    return true;
+                }
+            }
+        } catch (...) {
+        }
+        return false;
+    }
+
+    void handleJob(LocalSocket& client, unsigned long long jobId) {
+        auto fail = [&](const std::string& message) {
+            log("Job %llu: %s", jobId, message.c_str());
+            client.sendAll("error " + message + "\n");
+        };
+        auto status = [&](const std::string& text) {
+            return client.sendAll("status " + text + "\n");
+        };
+
+        // Request header
+        std::map<std::string, std::string> fields;
+        PDFProcessor::Options options;
+        std::string line;
+        for (;;) {
+            if (!client.readLine(line)) {
+                log("Job %llu: client disconnected before sending a request", jobId);
+                return;
+            }
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                break;
+            }
+            size_t space = line.find(' ');
+            std::string key = line.substr(0, space);
+            std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+            if (key == "input" || key == "input-size" || key == "output" || key == "compression") {
+                fields[key] = value;
+            } else if (!applyOption(options, key, value)) {
+                fail("invalid option '" + line + "'");
+                return;
+            }
+        }
+
+        // Uploaded input stays in memory; Poppler parses it in place
+        std::string uploadedInput;
+        std::string inputPath;
+        if (fields.count("input-size")) {
+            unsigned long long size = 0;
+            try {
+                size = std::stoull(fields["input-size"]);
+            } catch (...) {
+                fail("invalid input-size");
+                return;
+            }
+            if (size == 0 || size > config.maxInputBytes) {
+                fail("input-size out of range");
+                return;
+            }
+            uploadedInput.resize(static_cast<size_t>(size));
+            if (!client.recvAll(&uploadedInput[0], uploadedInput.size())) {
+                log("Job %llu: client disconnected during upload", jobId);
+                return;
+            }
+            inputPath = "(upload)";
+        } else if (fields.count("input")) {
+            if (!confinePath(fields["input"], inputPath)) {
+                fail(config.pathRoot.empty() ? "input paths are disabled; upload the PDF" :
+                     "input path outside the server's root");
+                return;
+            }
+        } else {
+            fail("missing input");
+            return;
+        }
+
+        // Without an output path the DXF is built in memory and sent back
+        std::string outputPath;
+        if (fields.count("output") && !confinePath(fields["output"], outputPath)) {
+            fail(config.pathRoot.empty() ? "output paths are disabled; omit output to receive the DXF" :
+                 "output path outside the server's root");
+            return;
+        }
+
+        log("Job %llu: converting %s -> %s", jobId, inputPath.c_str(),
+            outputPath.empty() ? "(reply)" : outputPath.c_str());
+
+        // Fresh pipeline objects per job keep jobs isolated from each other
+        PDFProcessor pdfProcessor;
+        CADGenerator cadGenerator;
+        if (outputPath.empty()) {
+            // A raster fallback would be a server-side file the returned
+            // drawing cannot reach, so pages over budget are left empty
+            options.budget.rasterFallback = false;
+        } else {
+            // Pages that fall back to a raster image go next to the output
+            std::filesystem::path outputStem = outputPath;
+            if (OutputSink::compressionForPath(outputPath) != OutputSink::Compression::None) {
+                outputStem.replace_extension();
+            }
+            options.imageDirectory = outputStem.replace_extension().string() + "_images";
+        }
+        pdfProcessor.setOptions(options);
+        if (fields.count("compression")) {
+            // Explicit codec for returned data, which has no file name to go by
+            CADGenerator::Options cadOptions = cadGenerator.getOptions();
+            const std::string& codec = fields["compression"];
+            if (codec == "gzip") {
+                cadOptions.output.compression = OutputSink::Compression::Gzip;
+            } else if (codec == "zstd") {
+                cadOptions.output.compression = OutputSink::Compression::Zstd;
+            } else if (codec == "none") {
+                cadOptions.output.compression = OutputSink::Compression::None;
+            } else {
+                fail("invalid compression '" + codec + "'");
+                return;
+            }
+            cadGenerator.setOptions(cadOptions);
+        }
+
+        if (!status("loading")) return;
+        bool loaded = uploadedInput.empty() ?
+            pdfProcessor.loadPDF(inputPath) :
+            pdfProcessor.loadPDFFromMemory(uploadedInput.data(), uploadedInput.size());
+        if (!loaded) {
+            fail("failed to load PDF");
+            return;
+        }
+
+        if (!status("extracting vectors")) return;
+        if (!pdfProcessor.extractVectors()) {
+            fail("failed to extract vector elements");
+            return;
+        }
+        for (const PDFProcessor::PageReport& report : pdfProcessor.getPageReports()) {
+            if (report.outcome != PDFProcessor::PageReport::Outcome::Full &&
+                !status("page " + std::to_string(report.page + 1) + " " +
+                        PDFProcessor::outcomeName(report.outcome) + " (over " + report.reason + " budget)")) {
+                return;
+            }
+        }
+
+        if (!status("extracting text")) return;
+        if (!pdfProcessor.extractText()) {
+            fail("failed to extract text elements");
+            return;
+        }
+
+        if (!status("writing " + std::to_string(pdfProcessor.getVectors().size()) + " vectors, " +
+                    std::to_string(pdfProcessor.getText().size()) + " text blocks")) return;
+        cadGenerator.setImageElements(pdfProcessor.getImageElements());
+        std::string output;
+        bool generated = false;
+        if (outputPath.empty()) {
+            std::unique_ptr<OutputSink> sink = OutputSink::toBuffer(output, cadGenerator.getOptions().output);
+            generated = cadGenerator.generateCAD(pdfProcessor.getVectors(), pdfProcessor.getText(), *sink);
+        } else {
+            generated = cadGenerator.generateCAD(pdfProcessor.getVectors(), pdfProcessor.getText(), outputPath);
+        }
+        if (!generated) {
+            fail("failed to generate CAD file");
+            return;
+        }
+        client.sendAll("ok " + std::to_string(output.size()) + "\n");
+        client.sendAll(output);
+        log("Job %llu: done (%zu bytes returned)", jobId, output.size());
+    }
+};
+
+ConversionServer::ConversionServer(const Config& config) : pimpl(std::make_unique<Impl>()) {
+    pimpl->config = config;
+}
+
+ConversionServer::~ConversionServer() {
+    stop();
+}
+
+bool ConversionServer::run() {
+    if (!pimpl->listener.listen(pimpl->config.socketPath)) {
+        log("Failed to listen on socket: %s", pimpl->config.socketPath.c_str());
+        return false;
+    }
+
+    pimpl->warmUp();
+
+    unsigned threads = pimpl->config.workerThreads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        pimpl->workers.emplace_back([this] { pimpl->workerLoop(); });
+    }
+    log("Conversion server listening on %s with %u workers",
+        pimpl->config.socketPath.c_str(), threads);
+    if (pimpl->config.pathRoot.empty()) {
+        log("File paths are disabled; jobs must upload their input");
+    } else {
+        log("Jobs may read and write files under %s", pimpl->config.pathRoot.c_str());
+    }
+
+    while (!pimpl->stopping) {
+        LocalSocket client = pimpl->listener.accept();
+        if (pimpl->stopping) {
+            break;
+        }
+        if (!client.isValid()) {
+            log("Warning: failed to accept connection");
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(pimpl->queueMutex);
+            pimpl->pendingJobs.push_back(std::move(client));
+        }
+        pimpl->queueReady.notify_one();
+    }
+
+    pimpl->queueReady.notify_all();
+    for (auto& worker : pimpl->workers) {
+        worker.join();
+    }
+    pimpl->workers.clear();
+    // Jobs still queued get an answer rather than a dropped connection
+    if (!pimpl->pendingJobs.empty()) {
+        log("Turning away %zu queued jobs", pimpl->pendingJobs.size());
+    }
+    for (LocalSocket& client : pimpl->pendingJobs) {
+        client.sendAll("error server is shutting down\n");
+    }
+    pimpl->pendingJobs.clear();
+    pimpl->listener.close();
+    log("Conversion server stopped");
+    return true;
+}
+
+void ConversionServer::stop() {
+    if (pimpl->stopping.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pimpl->queueMutex);
+    }
+    pimpl->queueReady.notify_all();
+
+    // Wake the blocked accept() with a throwaway connection
+    LocalSocket wake;
+    wake.connect(pimpl->config.socketPath);
+}
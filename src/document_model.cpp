@@ -0,0 +1,108 @@
+#include "document_model.hpp"
+#include "log.hpp"
+#include "document_model.pb.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#include <fstream>
+
+namespace {
+
+// Version 2 stores measured stroke widths in Entity.thickness. Version 1
+// files are still read; their thickness is not a width.
+const unsigned kFormatVersion = 2;
+const unsigned kOldestFormatVersion = 1;
+
+} // namespace
+
+class DocumentModelWriter::Impl {
+public:
+    std::ofstream file;
+    std::unique_ptr<google::protobuf::io::OstreamOutputStream> stream;
+};
+
+DocumentModelWriter::DocumentModelWriter() : pimpl(std::make_unique<Impl>()) {}
+
+DocumentModelWriter::~DocumentModelWriter() {
+    close();
+}
+
+bool DocumentModelWriter::open(const std::string& path, const pdf2cad::model::DocumentHeader& header) {
+    pimpl->file.open(path, std::ios::binary | std::ios::trunc);
+    if (!pimpl->file) {
+        log("Failed to open model file for writing: %s", path.c_str());
+        return false;
+    }
+    pimpl->stream = std::make_unique<google::protobuf::io::OstreamOutputStream>(&pimpl->file);
+
+    pdf2cad::model::DocumentHeader versioned = header;
+    versioned.set_format_version(kFormatVersion);
+    return google::protobuf::util::SerializeDelimitedToZeroCopyStream(versioned, pimpl->stream.get());
+}
+
+bool DocumentModelWriter::writePage(const pdf2cad::model::Page& page) {
+    return pimpl->stream &&
+        google::protobuf::util::SerializeDelimitedToZeroCopyStream(page, pimpl->stream.get());
+}
+
+bool DocumentModelWriter::close() {
+    if (!pimpl->stream) {
+        return false;
+    }
+    // The stream buffers internally; destroying it hands the rest to the file
+    pimpl->stream.reset();
+    pimpl->file.close();
+    return !pimpl->file.fail();
+}
+
+class DocumentModelReader::Impl {
+public:
+    std::ifstream file;
+    std::unique_ptr<google::protobuf::io::IstreamInputStream> stream;
+    pdf2cad::model::DocumentHeader header;
+};
+
+DocumentModelReader::DocumentModelReader() : pimpl(std::make_unique<Impl>()) {}
+DocumentModelReader::~DocumentModelReader() = default;
+
+bool DocumentModelReader::open(const std::string& path) {
+    pimpl->file.open(path, std::ios::binary);
+    if (!pimpl->file) {
+        log("Failed to open model file: %s", path.c_str());
+        return false;
+    }
+    pimpl->stream = std::make_unique<google::protobuf::io::IstreamInputStream>(&pimpl->file);
+
+    if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+            &pimpl->header, pimpl->stream.get(), nullptr)) {
+        log("Not a document model file: %s", path.c_str());
+        return false;
+    }
+    if (pimpl->header.format_version() < kOldestFormatVersion ||
+        pimpl->header.format_version() > kFormatVersion) {
+        log("Unsupported document model version %u in %s", pimpl->header.format_version(), path.c_str());
+        return false;
+    }
+    return true;
+}
+
+const pdf2cad::model::DocumentHeader& DocumentModelReader::getHeader() const {
+    return pimpl->header;
+}
+
+bool DocumentModelReader::readPage(pdf2cad::model::Page& page) {
+    // Parsing merges into the message, so start from an empty page
+    page.Clear();
+    return pimpl->stream &&
+        google::protobuf::util::ParseDelimitedFromZeroCopyStream(&page, pimpl->stream.get(), nullptr);
+}
+
+bool DocumentModelReader::skipPage() {
+    if (!pimpl->stream) {
+        return false;
+    }
+    // Unused buffered bytes are returned to the stream when `coded` goes away
+    google::protobuf::io::CodedInputStream coded(pimpl->stream.get());
+    uint32_t size = 0;
+    return coded.ReadVarint32(&size) && coded.Skip(static_cast<int>(size));
+}
@@ -0,0 +1,129 @@
+#include "geometry_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PDF2CAD_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace geometry {
+
+namespace {
+
+#ifdef PDF2CAD_HAVE_SSE2
+// Adding and subtracting 1.5 * 2^52 rounds to the nearest integer (ties to
+// even) in the default rounding mode, matching std::nearbyint below.
+const double kRoundMagic = 6755399441055744.0;
+
+inline __m128d roundToGrid(__m128d v, __m128d grid, __m128d invGrid, __m128d magic) {
+    __m128d q = _mm_mul_pd(v, invGrid);
+    q = _mm_sub_pd(_mm_add_pd(q, magic), magic);
+    return _mm_mul_pd(q, grid);
+}
+
+inline void storeExtents(__m128d lo, __m128d hi, Extents& extents) {
+    double mins[2], maxs[2];
+    _mm_storeu_pd(mins, lo);
+    _mm_storeu_pd(maxs, hi);
+    extents.minX = std::min(extents.minX, mins[0]);
+    extents.minY = std::min(extents.minY, mins[1]);
+    extents.maxX = std::max(extents.maxX, maxs[0]);
+    extents.maxY = std::max(extents.maxY, maxs[1]);
+}
+#endif
+
+} // namespace
+
+void Extents::merge(const Extents& other) {
+    minX = std::min(minX, other.minX);
+    minY = std::min(minY, other.minY);
+    maxX = std::max(maxX, other.maxX);
+    maxY = std::max(maxY, other.maxY);
+}
+
+Transform makePageTransform(double pageHeightPoints, double renderScale,
+                            double offsetX, double offsetY) {
+    Transform t;
+    t.sx = kPointsToMillimeters / renderScale;
+    t.sy = -kPointsToMillimeters / renderScale;
+    t.tx = offsetX;
+    t.ty = pageHeightPoints * kPointsToMillimeters + offsetY;
+    return t;
+}
+
+void transformPoints(double* xy, size_t count, const Transform& transform,
+                     double grid, Extents* extents) {
+    const bool snap = grid > 0.0;
+    const double invGrid = snap ? 1.0 / grid : 0.0;
+    size_t i = 0;
+
+#ifdef PDF2CAD_HAVE_SSE2
+    // One (x, y) pair per register, two pairs per iteration
+    const __m128d scale = _mm_set_pd(transform.sy, transform.sx);
+    const __m128d offset = _mm_set_pd(transform.ty, transform.tx);
+    const __m128d gridV = _mm_set1_pd(grid);
+    const __m128d invGridV = _mm_set1_pd(invGrid);
+    const __m128d magic = _mm_set1_pd(kRoundMagic);
+    __m128d lo = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d hi = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+
+    for (; i + 2 <= count; i += 2) {
+        __m128d a = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(xy + 2 * i), scale), offset);
+        __m128d b = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(xy + 2 * i + 2), scale), offset);
+        if (snap) {
+            a = roundToGrid(a, gridV, invGridV, magic);
+            b = roundToGrid(b, gridV, invGridV, magic);
+        }
+        _mm_storeu_pd(xy + 2 * i, a);
+        _mm_storeu_pd(xy + 2 * i + 2, b);
+        lo = _mm_min_pd(lo, _mm_min_pd(a, b));
+        hi = _mm_max_pd(hi, _mm_max_pd(a, b));
+    }
+    if (extents) {
+        storeExtents(lo, hi, *extents);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        double x = xy[2 * i] * transform.sx + transform.tx;
+        double y = xy[2 * i + 1] * transform.sy + transform.ty;
+        if (snap) {
+            x = std::nearbyint(x * invGrid) * grid;
+            y = std::nearbyint(y * invGrid) * grid;
+        }
+        xy[2 * i] = x;
+        xy[2 * i + 1] = y;
+        if (extents) {
+            extents->minX = std::min(extents->minX, x);
+            extents->minY = std::min(extents->minY, y);
+            extents->maxX = std::max(extents->maxX, x);
+            extents->maxY = std::max(extents->maxY, y);
+        }
+    }
+}
+
+void accumulateExtents(const double* xy, size_t count, Extents& extents) {
+    size_t i = 0;
+
+#ifdef PDF2CAD_HAVE_SSE2
+    __m128d lo = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d hi = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    for (; i + 2 <= count; i += 2) {
+        __m128d a = _mm_loadu_pd(xy + 2 * i);
+        __m128d b = _mm_loadu_pd(xy + 2 * i + 2);
+        lo = _mm_min_pd(lo, _mm_min_pd(a, b));
+        hi = _mm_max_pd(hi, _mm_max_pd(a, b));
+    }
+    storeExtents(lo, hi, extents);
+#endif
+
+    for (; i < count; ++i) {
+        extents.minX = std::min(extents.minX, xy[2 * i]);
+        extents.minY = std::min(extents.minY, xy[2 * i + 1]);
+        extents.maxX = std::max(extents.maxX, xy[2 * i]);
+        extents.maxY = std::max(extents.maxY, xy[2 * i + 1]);
+    }
+}
+
+} // namespace geometry
@@ -0,0 +1,388 @@
+#include "image_extractor.hpp"
+#include "log.hpp"
+#include <PDFDoc.h>
+#include <OutputDev.h>
+#include <GfxState.h>
+#include <Stream.h>
+#include <Object.h>
+#include <goo/GooString.h>
+#include <png.h>
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// 64-bit FNV-1a, fed incrementally while data streams through
+struct ContentHash {
+    unsigned long long value = 14695981039346656037ULL;
+
+    void update(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            value = (value ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    std::string hex() const {
+        char buffer[17];
+        snprintf(buffer, sizeof(buffer), "%016llx", value);
+        return buffer;
+    }
+};
+
+// PNG file written one row at a time, so no image is ever held whole.
+// libpng reports errors by longjmp, so every call into it sits in a member
+// function with nothing to unwind.
+class PngFile {
+public:
+    explicit PngFile(const std::filesystem::path& path) {
+        file = fopen(path.string().c_str(), "wb");
+        if (file) {
+            png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+            info = png ? png_create_info_struct(png) : nullptr;
+        }
+    }
+
+    ~PngFile() {
+        if (png) {
+            png_destroy_write_struct(&png, &info);
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    PngFile(const PngFile&) = delete;
+    PngFile& operator=(const PngFile&) = delete;
+
+    bool begin(int width, int height, bool gray) {
+        if (!info || setjmp(png_jmpbuf(png))) {
+            return false;
+        }
+        png_init_io(png, file);
+        // OpenCV's imwrite default, which these files were written with before
+        png_set_compression_level(png, 1);
+        png_set_IHDR(png, info, width, height, 8, gray ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGB,
+                     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        png_write_info(png, info);
+        return true;
+    }
+
+    bool writeRow(const unsigned char* row) {
+        if (setjmp(png_jmpbuf(png))) {
+            return false;
+        }
+        png_write_row(png, row);
+        return true;
+    }
+
+    // Writes the trailer and closes the file
+    bool end() {
+        if (setjmp(png_jmpbuf(png))) {
+            return false;
+        }
+        png_write_end(png, nullptr);
+        FILE* closing = file;
+        file = nullptr;
+        return fclose(closing) == 0;
+    }
+
+private:
+    FILE* file = nullptr;
+    png_structp png = nullptr;
+    png_infop info = nullptr;
+};
+
+} // namespace
+
+class ImageExtractor::Impl {
+public:
+    std::filesystem::path directory;
+    std::unique_ptr<PDFDoc> doc;
+    Stats stats;
+    std::map<std::pair<int, int>, std::string> exportedRefs;  // XObject ref -> file
+    size_t partialCounter = 0;
+
+    // Checks the just opened document and creates the output directory
+    bool openDirectory();
+
+    // Moves a finished temporary file to its content-addressed name, or drops
+    // it when that content was already exported. The hash only picks the
+    // name: a file already there is compared byte for byte, and different
+    // content under the same hash gets the next free "-N" suffix.
+    std::string commit(const std::filesystem::path& partial, const ContentHash& hash,
+                       const char* extension) {
+        std::error_code ec;
+        for (int suffix = 0;; ++suffix) {
+            std::string name = "img_" + hash.hex();
+            if (suffix > 0) {
+                name += "-" + std::to_string(suffix);
+            }
+            std::filesystem::path target = directory / (name + extension);
+            if (std::filesystem::exists(target, ec)) {
+                if (!sameContents(partial, target)) {
+                    continue;
+                }
+                std::filesystem::remove(partial, ec);
+                stats.dedupedByHash++;
+                return target.string();
+            }
+            std::filesystem::rename(partial, target, ec);
+            if (ec) {
+                log("Warning: failed to store image %s: %s", target.string().c_str(), ec.message().c_str());
+                std::filesystem::remove(partial, ec);
+                return "";
+            }
+            stats.uniqueImages++;
+            return target.string();
+        }
+    }
+
+    static bool sameContents(const std::filesystem::path& a, const std::filesystem::path& b) {
+        std::error_code ec;
+        if (std::filesystem::file_size(a, ec) != std::filesystem::file_size(b, ec) || ec) {
+            return false;
+        }
+        FILE* fileA = fopen(a.string().c_str(), "rb");
+        FILE* fileB = fopen(b.string().c_str(), "rb");
+        bool same = fileA && fileB;
+        unsigned char bufferA[65536], bufferB[65536];
+        while (same) {
+            size_t readA = fread(bufferA, 1, sizeof(bufferA), fileA);
+            size_t readB = fread(bufferB, 1, sizeof(bufferB), fileB);
+            same = readA == readB && std::equal(bufferA, bufferA + readA, bufferB);
+            if (readA < sizeof(bufferA)) {
+                break;
+            }
+        }
+        if (fileA) fclose(fileA);
+        if (fileB) fclose(fileB);
+        return same;
+    }
+
+    // Copies the undecoded JPEG bytes straight to disk
+    std::string passThroughJPEG(Stream* str) {
+        Stream* encoded = str->getNextStream();
+        std::filesystem::path partial = directory / (".partial-" + std::to_string(partialCounter++) + ".jpg");
+        FILE* file = fopen(partial.string().c_str(), "wb");
+        if (!file) {
+            return "";
+        }
+
+        ContentHash hash;
+        unsigned char buffer[65536];
+        size_t filled = 0;
+        bool ok = true;
+        encoded->reset();
+        for (int c = encoded->getChar(); c != EOF; c = encoded->getChar()) {
+            buffer[filled++] = static_cast<unsigned char>(c);
+            if (filled == sizeof(buffer)) {
+                hash.update(buffer, filled);
+                ok = ok && fwrite(buffer, 1, filled, file) == filled;
+                filled = 0;
+            }
+        }
+        hash.update(buffer, filled);
+        ok = ok && fwrite(buffer, 1, filled, file) == filled;
+        encoded->close();
+        ok = fclose(file) == 0 && ok;
+
+        if (!ok) {
+            std::error_code ec;
+            std::filesystem::remove(partial, ec);
+            return "";
+        }
+        stats.passedThrough++;
+        return commit(partial, hash, ".jpg");
+    }
+
+    // Decodes row by row and writes each row to the PNG as it comes, so
+    // only one row of the image is in memory at a time
+    std::string decodeToPNG(Stream* str, int width, int height, GfxImageColorMap* colorMap) {
+        bool gray = colorMap->getNumPixelComps() == 1 &&
+            colorMap->getColorSpace()->getMode() == csDeviceGray;
+        const size_t rowBytes = static_cast<size_t>(width) * (gray ? 1 : 3);
+        std::vector<unsigned char> row(rowBytes);
+
+        ContentHash hash;
+        hash.update(&width, sizeof(width));
+        hash.update(&height, sizeof(height));
+        hash.update(&gray, sizeof(gray));
+
+        // Encoded in full even when the hash is known, so commit() can
+        // compare it with the file already there
+        std::filesystem::path partial = directory / (".partial-" + std::to_string(partialCounter++) + ".png");
+        bool ok;
+        {
+            PngFile png(partial);
+            ok = png.begin(width, height, gray);
+
+            ImageStream imgStr(str, width, colorMap->getNumPixelComps(), colorMap->getBits());
+            imgStr.reset();
+            for (int y = 0; ok && y < height; ++y) {
+                unsigned char* line = imgStr.getLine();
+                if (!line) {
+                    std::fill(row.begin(), row.end(), 0);
+                } else if (gray) {
+                    colorMap->getGrayLine(line, row.data(), width);
+                } else {
+                    colorMap->getRGBLine(line, row.data(), width);
+                }
+                hash.update(row.data(), rowBytes);
+                ok = png.writeRow(row.data());
+            }
+            imgStr.close();
+            ok = ok && png.end();
+        }
+
+        if (!ok) {
+            std::error_code ec;
+            std::filesystem::remove(partial, ec);
+            return "";
+        }
+        return commit(partial, hash, ".png");
+    }
+
+    void handleImage(GfxState* state, Object* ref, Stream* str, int width, int height,
+                     GfxImageColorMap* colorMap, bool inlineImg, std::vector<Placement>& out) {
+        if (width <= 0 || height <= 0 || !colorMap || !colorMap->isOk()) {
+            return;
+        }
+
+        // The image's unit square mapped to page space
+        const double* ctm = state->getCTM();
+        Placement placement;
+        placement.pixelWidth = width;
+        placement.pixelHeight = height;
+        placement.x = ctm[4];
+        placement.y = ctm[5];
+        placement.uX = ctm[0] / width;
+        placement.uY = ctm[1] / width;
+        placement.vX = ctm[2] / height;
+        placement.vY = ctm[3] / height;
+        stats.placements++;
+
+        // Repeated placements of the same XObject are never decoded again
+        std::pair<int, int> key(-1, -1);
+        if (ref && ref->isRef()) {
+            key = std::make_pair(ref->getRef().num, ref->getRef().gen);
+            auto found = exportedRefs.find(key);
+            if (found != exportedRefs.end()) {
+                stats.dedupedByRef++;
+                placement.path = found->second;
+                out.push_back(placement);
+                return;
+            }
+        }
+
+        int comps = colorMap->getNumPixelComps();
+        if (!inlineImg && str->getKind() == strDCT && (comps == 1 || comps == 3)) {
+            placement.path = passThroughJPEG(str);
+        } else {
+            placement.path = decodeToPNG(str, width, height, colorMap);
+        }
+
+        if (placement.path.empty()) {
+            log("Warning: failed to export %dx%d image", width, height);
+            stats.failed++;
+            return;
+        }
+        if (key.first >= 0) {
+            exportedRefs[key] = placement.path;
+        }
+        out.push_back(placement);
+    }
+
+    // Receives image draws while Poppler interprets a page; everything else is
+    // ignored. With upsideDown() false the device space is PDF user space at 72 DPI.
+    class PlacementCollector : public OutputDev {
+    public:
+        PlacementCollector(Impl& extractor, std::vector<ImageExtractor::Placement>& placements)
+            : extractor(extractor), placements(placements) {}
+
+        bool upsideDown() override { return false; }
+        bool useDrawChar() override { return false; }
+        bool interpretType3Chars() override { return false; }
+
+        void drawImage(GfxState* state, Object* ref, Stream* str, int width, int height,
+                       GfxImageColorMap* colorMap, bool interpolate, const int* maskColors,
+                       bool inlineImg) override {
+            extractor.handleImage(state, ref, str, width, height, colorMap, inlineImg, placements);
+        }
+
+        void drawMaskedImage(GfxState* state, Object* ref, Stream* str, int width, int height,
+                             GfxImageColorMap* colorMap, bool interpolate, Stream* maskStr,
+                             int maskWidth, int maskHeight, bool maskInvert, bool maskInterpolate) override {
+            extractor.handleImage(state, ref, str, width, height, colorMap, false, placements);
+        }
+
+        void drawSoftMaskedImage(GfxState* state, Object* ref, Stream* str, int width, int height,
+                                 GfxImageColorMap* colorMap, bool interpolate, Stream* maskStr,
+                                 int maskWidth, int maskHeight, GfxImageColorMap* maskColorMap,
+                                 bool maskInterpolate) override {
+            extractor.handleImage(state, ref, str, width, height, colorMap, false, placements);
+        }
+
+    private:
+        Impl& extractor;
+        std::vector<ImageExtractor::Placement>& placements;
+    };
+};
+
+ImageExtractor::ImageExtractor(const std::string& outputDirectory) : pimpl(std::make_unique<Impl>()) {
+    pimpl->directory = outputDirectory;
+}
+
+ImageExtractor::~ImageExtractor() = default;
+
+bool ImageExtractor::open(const std::string& pdfPath) {
+    // Poppler's global parameters are already set up by the poppler-cpp
+    // document that PDFProcessor keeps open
+    pimpl->doc = std::make_unique<PDFDoc>(std::make_unique<GooString>(pdfPath));
+    return pimpl->openDirectory();
+}
+
+bool ImageExtractor::open(const char* data, size_t size) {
+    // The stream reads the caller's bytes in place and the document owns the stream
+    pimpl->doc = std::make_unique<PDFDoc>(new MemStream(data, 0, static_cast<Goffset>(size), Object(objNull)));
+    return pimpl->openDirectory();
+}
+
+bool ImageExtractor::Impl::openDirectory() {
+    if (!doc->isOk()) {
+        log("Failed to open PDF for image extraction (error %d)", doc->getErrorCode());
+        doc.reset();
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        log("Failed to create image directory %s: %s",
+            directory.string().c_str(), ec.message().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ImageExtractor::extractPage(int pageIndex, std::vector<Placement>& placements) {
+    if (!pimpl->doc || pageIndex < 0 || pageIndex >= pimpl->doc->getNumPages()) {
+        return false;
+    }
+
+    Impl::PlacementCollector collector(*pimpl, placements);
+    pimpl->doc->displayPage(&collector, pageIndex + 1, 72.0, 72.0, 0,
+        false,   // Use the crop box, like the rendered page
+        true,    // Crop
+        false);  // Not printing
+    return true;
+}
+
+const ImageExtractor::Stats& ImageExtractor::getStats() const {
+    return pimpl->stats;
+}
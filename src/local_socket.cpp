@@ -0,0 +1,262 @@
+#include "local_socket.hpp"
+#include "log.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET native_socket;
+typedef int io_size;
+static const long long kInvalidHandle = static_cast<long long>(INVALID_SOCKET);
+static const int kSendFlags = 0;
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int native_socket;
+typedef size_t io_size;
+static const long long kInvalidHandle = -1;
+static const int kSendFlags = MSG_NOSIGNAL;  // Report a vanished peer as an error, not SIGPIPE
+#endif
+
+namespace {
+
+#ifdef _WIN32
+// Winsock must be initialized once per process before any socket call
+struct WinsockInit {
+    WinsockInit() {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+    }
+    ~WinsockInit() { WSACleanup(); }
+};
+
+void ensureWinsock() {
+    static WinsockInit init;
+}
+#else
+void ensureWinsock() {}
+#endif
+
+bool makeAddress(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+void closeNative(long long handle) {
+#ifdef _WIN32
+    closesocket(static_cast<native_socket>(handle));
+#else
+    ::close(static_cast<native_socket>(handle));
+#endif
+}
+
+int lastSocketError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+// A socket file whose server is gone: connecting to it is refused
+bool isStaleSocket(const std::string& path, const sockaddr_un& addr) {
+#ifdef _WIN32
+    // Unix sockets show up as reparse points
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+        return false;
+    }
+    const int refused = WSAECONNREFUSED;
+#else
+    struct stat info;
+    if (::lstat(path.c_str(), &info) != 0 || !S_ISSOCK(info.st_mode)) {
+        return false;
+    }
+    const int refused = ECONNREFUSED;
+#endif
+    native_socket probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (static_cast<long long>(probe) == kInvalidHandle) {
+        return false;
+    }
+    bool stale = ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 &&
+        lastSocketError() == refused;
+    closeNative(static_cast<long long>(probe));
+    return stale;
+}
+
+} // namespace
+
+LocalSocket::LocalSocket() : handle(kInvalidHandle) {}
+
+LocalSocket::LocalSocket(long long handle) : handle(handle) {}
+
+LocalSocket::~LocalSocket() {
+    close();
+}
+
+LocalSocket::LocalSocket(LocalSocket&& other) noexcept
+    : handle(other.handle), boundPath(std::move(other.boundPath)), pending(std::move(other.pending)) {
+    other.handle = kInvalidHandle;
+    other.boundPath.clear();
+}
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) noexcept {
+    if (this != &other) {
+        close();
+        handle = other.handle;
+        boundPath = std::move(other.boundPath);
+        pending = std::move(other.pending);
+        other.handle = kInvalidHandle;
+        other.boundPath.clear();
+    }
+    return *this;
+}
+
+bool LocalSocket::listen(const std::string& path, int backlog) {
+    ensureWinsock();
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) {
+        return false;
+    }
+
+    native_socket s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (static_cast<long long>(s) == kInvalidHandle) {
+        return false;
+    }
+
+    // A socket file left behind by a previous run would make bind() fail.
+    // Anything else is not ours to delete, so bind() fails on it instead.
+    if (isStaleSocket(path, addr)) {
+        ::remove(path.c_str());
+    }
+    if (::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+#ifdef _WIN32
+        const bool inUse = lastSocketError() == WSAEADDRINUSE;
+#else
+        const bool inUse = lastSocketError() == EADDRINUSE;
+#endif
+        if (inUse) {
+            log("Cannot listen on %s: address in use", path.c_str());
+        }
+        closeNative(static_cast<long long>(s));
+        return false;
+    }
+    if (::listen(s, backlog) != 0) {
+        closeNative(static_cast<long long>(s));
+        return false;
+    }
+
+    close();
+    handle = static_cast<long long>(s);
+    boundPath = path;
+    return true;
+}
+
+bool LocalSocket::connect(const std::string& path) {
+    ensureWinsock();
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) {
+        return false;
+    }
+
+    native_socket s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (static_cast<long long>(s) == kInvalidHandle) {
+        return false;
+    }
+    if (::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        closeNative(static_cast<long long>(s));
+        return false;
+    }
+
+    close();
+    handle = static_cast<long long>(s);
+    return true;
+}
+
+LocalSocket LocalSocket::accept() {
+    if (!isValid()) {
+        return LocalSocket();
+    }
+    native_socket s = ::accept(static_cast<native_socket>(handle), nullptr, nullptr);
+    return LocalSocket(static_cast<long long>(s));
+}
+
+bool LocalSocket::sendAll(const char* data, size_t size) {
+    while (size > 0) {
+        io_size chunk = static_cast<io_size>(std::min<size_t>(size, 1 << 20));
+        auto sent = ::send(static_cast<native_socket>(handle), data, chunk, kSendFlags);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool LocalSocket::recvAll(char* data, size_t size) {
+    // Serve bytes already buffered by readLine() first
+    size_t fromPending = std::min(size, pending.size());
+    std::memcpy(data, pending.data(), fromPending);
+    pending.erase(0, fromPending);
+    data += fromPending;
+    size -= fromPending;
+
+    while (size > 0) {
+        io_size chunk = static_cast<io_size>(std::min<size_t>(size, 1 << 20));
+        auto got = ::recv(static_cast<native_socket>(handle), data, chunk, 0);
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool LocalSocket::readLine(std::string& line) {
+    for (;;) {
+        size_t newline = pending.find('\n');
+        if (newline != std::string::npos) {
+            line.assign(pending, 0, newline);
+            pending.erase(0, newline + 1);
+            return true;
+        }
+        if (pending.size() > kMaxLineBytes) {
+            return false;
+        }
+
+        char buffer[4096];
+        auto got = ::recv(static_cast<native_socket>(handle), buffer, sizeof(buffer), 0);
+        if (got <= 0) {
+            return false;
+        }
+        pending.append(buffer, static_cast<size_t>(got));
+    }
+}
+
+bool LocalSocket::isValid() const {
+    return handle != kInvalidHandle;
+}
+
+void LocalSocket::close() {
+    if (isValid()) {
+        closeNative(handle);
+        handle = kInvalidHandle;
+    }
+    if (!boundPath.empty()) {
+        ::remove(boundPath.c_str());
+        boundPath.clear();
+    }
+}
@@ -0,0 +1,58 @@
+#include "log.hpp"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+
+namespace {
+
+std::mutex& logMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+LogHandler& logHandler() {
+    static LogHandler handler = [](const char* line) {
+        printf("%s\n", line);
+        fflush(stdout);
+    };
+    return handler;
+}
+
+} // namespace
+
+void setLogHandler(LogHandler handler) {
+    std::lock_guard<std::mutex> lock(logMutex());
+    logHandler() = std::move(handler);
+}
+
+void log(const char* format, ...) {
+    char buffer[4096];
+
+    // Format the message with timestamp
+    auto now = std::chrono::system_clock::now();
+    std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+    int millis = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        now.time_since_epoch()).count() % 1000);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    int prefixLen = snprintf(buffer, sizeof(buffer),
+        "[%04d-%02d-%02d %02d:%02d:%02d.%03d] ",
+        local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+        local.tm_hour, local.tm_min, local.tm_sec, millis);
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer + prefixLen, sizeof(buffer) - prefixLen, format, args);
+    va_end(args);
+
+    std::lock_guard<std::mutex> lock(logMutex());
+    if (logHandler()) {
+        logHandler()(buffer);
+    }
+}
@@ -1,11 +1,13 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "pdf_processor.hpp"
 #include "cad_generator.hpp"
+#include "conversion_server.hpp"
+#include "conversion_pipeline.hpp"
+#include "log.hpp"
 #include <iostream>
 #include <string>
 #include <algorithm>
 #include <cstdio>
-#include <cstdarg>
 #include <cerrno>
 #include <cstring>
 #include <direct.h>
@@ -14,36 +16,20 @@
 #include <fstream>
 #pragma comment(lib, "shlwapi.lib")
 
-void log(const char* format, ...) {
-    char buffer[4096];
-    va_list args;
-    va_start(args, format);
-    
-    // Format the message with timestamp
-    SYSTEMTIME st;
-    GetLocalTime(&st);
-    int prefixLen = snprintf(buffer, sizeof(buffer), 
-        "[%04d-%02d-%02d %02d:%02d:%02d.%03d] ",
-        st.wYear, st.wMonth, st.wDay,
-        st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
-    
-    vsnprintf(buffer + prefixLen, sizeof(buffer) - prefixLen, format, args);
-    va_end(args);
-    
-    // Add newline
-    strcat(buffer, "\n");
-    
+// Library log lines also go to the debugger and a log file
+void logToWindows(const char* line) {
     // Write to stdout
-    printf("%s", buffer);
+    printf("%s\n", line);
     fflush(stdout);
-    
+
     // Write to Windows debug output
-    OutputDebugStringA(buffer);
-    
+    OutputDebugStringA(line);
+    OutputDebugStringA("\n");
+
     // Write to file
     static std::ofstream logFile("C:/Users/USER/Desktop/pdf2cad/debug_log.txt", std::ios::app);
     if (logFile.is_open()) {
-        logFile << buffer;
+        logFile << line << "\n";
         logFile.flush();
     }
 }
@@ -54,17 +40,69 @@ bool has_suffix(const std::string& str, const std::string& suffix) {
 }
 
 void printUsage() {
-    log("Usage: pdf2cad <input.pdf> <output.dxf/dwg>");
+    log("Usage: pdf2cad <input.pdf/model.pb> <output.dxf/dxf.gz/dxf.zst/dwg> [--symbols]");
+    log("                [--compress none|gzip|zstd] [--compress-thread] [--save-model <model.pb>]");
+    log("                [--vectorizer contours|segments|centerline]");
+    log("                [--page-seconds <s>] [--page-max-paths <n>] [--page-max-entities <n>]");
+    log("                [--pipeline [--render-workers <n>] [--vectorize-workers <n>]]");
+    log("       pdf2cad --serve <socket-path> [--workers <n>] [--path-root <dir>]");
+}
+
+// The running server, so Ctrl+C and console close can stop it cleanly
+ConversionServer* activeServer = nullptr;
+
+BOOL WINAPI stopServerOnConsoleEvent(DWORD event) {
+    switch (event) {
+        case CTRL_C_EVENT:
+        case CTRL_BREAK_EVENT:
+        case CTRL_CLOSE_EVENT:
+        case CTRL_SHUTDOWN_EVENT:
+            // Runs on its own thread; run() returns once workers finish their jobs
+            log("Stopping conversion server...");
+            activeServer->stop();
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+int runServer(int argc, char* argv[]) {
+    ConversionServer::Config config;
+    config.socketPath = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            config.workerThreads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--path-root") == 0 && i + 1 < argc) {
+            config.pathRoot = argv[++i];
+        } else {
+            log("Error: Unknown server option: %s", argv[i]);
+            printUsage();
+            return 1;
+        }
+    }
+
+    ConversionServer server(config);
+    activeServer = &server;
+    SetConsoleCtrlHandler(stopServerOnConsoleEvent, TRUE);
+    bool ok = server.run();
+    SetConsoleCtrlHandler(stopServerOnConsoleEvent, FALSE);
+    activeServer = nullptr;
+    return ok ? 0 : 1;
 }
 
 int main(int argc, char* argv[]) {
     int result = 1;  // Default to error
+    setLogHandler(logToWindows);
     try {
         std::cout << "pdf2cad starting..." << std::endl;
         log("pdf2cad starting...");
+
+        if (argc >= 3 && strcmp(argv[1], "--serve") == 0) {
+            return runServer(argc, argv);
+        }
         
         // Check arguments
-        if (argc != 3) {
+        if (argc < 3) {
             std::cout << "Error: Invalid number of arguments" << std::endl;
             log("Error: Invalid number of arguments");
             printUsage();
@@ -105,43 +143,164 @@ int main(int argc, char* argv[]) {
         PDFProcessor pdfProcessor;
         CADGenerator cadGenerator;
 
-        // Load and process PDF
-        log("Loading PDF file: %s", inputPath.c_str());
-        if (!pdfProcessor.loadPDF(inputPath)) {
-            log("Failed to load PDF file: %s", inputPath.c_str());
-            goto cleanup;
-        }
-        log("PDF loaded successfully");
-
-        // Extract elements
-        log("Extracting vectors from PDF...");
-        if (!pdfProcessor.extractVectors()) {
-            log("Failed to extract vector elements");
-            goto cleanup;
+        // Extracted images go next to the output, e.g. drawing.dxf.gz -> drawing_images/
+        PDFProcessor::Options pdfOptions = pdfProcessor.getOptions();
+        std::string outputStem = outputPath;
+        if (OutputSink::compressionForPath(outputStem) != OutputSink::Compression::None) {
+            outputStem = outputStem.substr(0, outputStem.find_last_of('.'));
         }
-        log("Vector extraction completed");
+        pdfOptions.imageDirectory = outputStem.substr(0, outputStem.find_last_of('.')) + "_images";
 
-        log("Extracting text from PDF...");
-        if (!pdfProcessor.extractText()) {
-            log("Failed to extract text elements");
-            goto cleanup;
+        CADGenerator::Options cadOptions = cadGenerator.getOptions();
+        bool fromModel = has_suffix(inputPath, ".pb");
+        std::string modelPath;
+        bool pipelined = false;
+        ConversionPipeline::Options pipelineOptions;
+        for (int i = 3; i < argc; ++i) {
+            if (strcmp(argv[i], "--pipeline") == 0) {
+                pipelined = true;
+            } else if (strcmp(argv[i], "--render-workers") == 0 && i + 1 < argc) {
+                pipelineOptions.renderWorkers = static_cast<unsigned>(atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--vectorize-workers") == 0 && i + 1 < argc) {
+                pipelineOptions.vectorizeWorkers = static_cast<unsigned>(atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--vectorizer") == 0 && i + 1 < argc) {
+                ++i;
+                if (strcmp(argv[i], "contours") == 0) {
+                    pdfOptions.vectorizer = RasterVectorizer::Backend::Contours;
+                } else if (strcmp(argv[i], "segments") == 0) {
+                    pdfOptions.vectorizer = RasterVectorizer::Backend::Segments;
+                } else if (strcmp(argv[i], "centerline") == 0) {
+                    pdfOptions.vectorizer = RasterVectorizer::Backend::Centerline;
+                } else {
+                    log("Error: Unknown vectorizer: %s", argv[i]);
+                    printUsage();
+                    goto cleanup;
+                }
+            } else if (strcmp(argv[i], "--page-seconds") == 0 && i + 1 < argc) {
+                pdfOptions.budget.maxSeconds = atof(argv[++i]);
+            } else if (strcmp(argv[i], "--page-max-paths") == 0 && i + 1 < argc) {
+                pdfOptions.budget.maxPaths = strtoull(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--page-max-entities") == 0 && i + 1 < argc) {
+                pdfOptions.budget.maxEntities = strtoull(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--save-model") == 0 && i + 1 < argc) {
+                modelPath = argv[++i];
+            } else if (strcmp(argv[i], "--symbols") == 0) {
+                cadOptions.instanceSymbols = true;
+            } else if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
+                ++i;
+                if (strcmp(argv[i], "none") == 0) {
+                    cadOptions.output.compression = OutputSink::Compression::None;
+                } else if (strcmp(argv[i], "gzip") == 0) {
+                    cadOptions.output.compression = OutputSink::Compression::Gzip;
+                } else if (strcmp(argv[i], "zstd") == 0) {
+                    cadOptions.output.compression = OutputSink::Compression::Zstd;
+                } else {
+                    log("Error: Unknown compression: %s", argv[i]);
+                    printUsage();
+                    goto cleanup;
+                }
+            } else if (strcmp(argv[i], "--compress-thread") == 0) {
+                cadOptions.output.compressionThread = true;
+            } else {
+                log("Error: Unknown option: %s", argv[i]);
+                printUsage();
+                goto cleanup;
+            }
         }
-        log("Text extraction completed");
+        cadGenerator.setOptions(cadOptions);
+        pdfProcessor.setOptions(pdfOptions);
 
         // Check output format
         log("Checking output format...");
-        bool isDXF = has_suffix(outputPath, ".dxf");
+        bool isDXF = has_suffix(outputStem, ".dxf");
         bool isDWG = has_suffix(outputPath, ".dwg");
         
         if (!isDXF && !isDWG) {
-            log("Error: Unsupported output format. Only .dxf and .dwg are supported");
+            log("Error: Unsupported output format. Only .dxf (optionally .gz/.zst) and .dwg are supported");
             goto cleanup;
         }
         log("Output format is valid: %s", isDXF ? "DXF" : "DWG");
+        if (isDXF) {
+            OutputSink::Compression compression = cadOptions.output.compression;
+            if (compression == OutputSink::Compression::Auto) {
+                compression = OutputSink::compressionForPath(outputPath);
+            }
+            log("Output compression: %s", OutputSink::compressionName(compression));
+        }
+
+        if (pipelined && (fromModel || !isDXF || !modelPath.empty() || cadOptions.instanceSymbols)) {
+            // Streaming needs a PDF in and a DXF out, and the model and
+            // symbols need every element at once
+            log("--pipeline does not apply with these options; converting in phases");
+            pipelined = false;
+        }
+        if (pipelined) {
+            log("Converting with the pipeline: %s", outputPath.c_str());
+            ConversionPipeline pipeline(pdfProcessor, cadGenerator);
+            pipeline.setOptions(pipelineOptions);
+            if (!pipeline.convert(inputPath, outputPath)) {
+                log("Pipelined conversion failed");
+                goto cleanup;
+            }
+            log("Conversion completed successfully");
+            result = 0;
+            goto cleanup;
+        }
+
+        if (fromModel) {
+            // Extraction already ran; re-emit its saved result
+            log("Loading document model: %s", inputPath.c_str());
+            if (!cadGenerator.importModel(inputPath)) {
+                log("Failed to load document model: %s", inputPath.c_str());
+                goto cleanup;
+            }
+        } else {
+            // Load and process PDF
+            log("Loading PDF file: %s", inputPath.c_str());
+            if (!pdfProcessor.loadPDF(inputPath)) {
+                log("Failed to load PDF file: %s", inputPath.c_str());
+                goto cleanup;
+            }
+            log("PDF loaded successfully");
+
+            // Extract elements
+            log("Extracting vectors from PDF...");
+            if (!pdfProcessor.extractVectors()) {
+                log("Failed to extract vector elements");
+                goto cleanup;
+            }
+            log("Vector extraction completed");
+
+            log("Extracting text from PDF...");
+            if (!pdfProcessor.extractText()) {
+                log("Failed to extract text elements");
+                goto cleanup;
+            }
+            log("Text extraction completed");
+
+            log("Extracting images from PDF...");
+            if (!pdfProcessor.extractImages()) {
+                log("Failed to extract image elements");
+                goto cleanup;
+            }
+            cadGenerator.setImageElements(pdfProcessor.getImageElements());
+            log("Image extraction completed");
+
+            if (!modelPath.empty()) {
+                log("Saving document model: %s", modelPath.c_str());
+                if (!pdfProcessor.exportModel(modelPath)) {
+                    log("Failed to save document model");
+                    goto cleanup;
+                }
+            }
+        }
 
         // Generate CAD file
         log("Generating CAD file: %s", outputPath.c_str());
-        if (!cadGenerator.generateCAD(pdfProcessor.getVectors(), pdfProcessor.getText(), outputPath)) {
+        bool generated = fromModel ?
+            cadGenerator.generateCAD(outputPath, CADGenerator::Format::DXF) :
+            cadGenerator.generateCAD(pdfProcessor.getVectors(), pdfProcessor.getText(), outputPath);
+        if (!generated) {
             log("Failed to generate CAD file");
             goto cleanup;
         }
@@ -0,0 +1,396 @@
+#include "output_sink.hpp"
+#include "log.hpp"
+#include <zlib.h>
+#include <zstd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool hasSuffix(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Uncompressed output to a file
+class FileSink : public OutputSink {
+public:
+    explicit FileSink(FILE* file) : file(file) {}
+
+    ~FileSink() override {
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    bool write(const char* data, size_t size) override {
+        stats.bytesIn += size;
+        if (ok && size > 0) {
+            ok = fwrite(data, 1, size, file) == size;
+            stats.bytesOut += size;
+        }
+        return ok;
+    }
+
+    bool finish() override {
+        if (file) {
+            ok = fclose(file) == 0 && ok;
+            file = nullptr;
+        }
+        return ok;
+    }
+
+    const Stats& getStats() const override { return stats; }
+
+private:
+    FILE* file;
+    Stats stats;
+    bool ok = true;
+};
+
+// Uncompressed output appended to a caller's buffer
+class BufferSink : public OutputSink {
+public:
+    explicit BufferSink(std::string& buffer) : buffer(buffer) {}
+
+    bool write(const char* data, size_t size) override {
+        buffer.append(data, size);
+        stats.bytesIn += size;
+        stats.bytesOut += size;
+        return true;
+    }
+
+    bool finish() override { return true; }
+
+    const Stats& getStats() const override { return stats; }
+
+private:
+    std::string& buffer;
+    Stats stats;
+};
+
+// Passes everything on to a sink the caller keeps ownership of
+class ForwardingSink : public OutputSink {
+public:
+    explicit ForwardingSink(OutputSink& destination) : destination(destination) {}
+
+    bool write(const char* data, size_t size) override {
+        return destination.write(data, size);
+    }
+
+    bool finish() override {
+        return destination.finish();
+    }
+
+    const Stats& getStats() const override { return destination.getStats(); }
+
+private:
+    OutputSink& destination;
+};
+
+// Base of the compressing sinks: compressed bytes go to `inner`
+class EncoderSink : public OutputSink {
+public:
+    explicit EncoderSink(std::unique_ptr<OutputSink> inner) : inner(std::move(inner)) {}
+
+    const Stats& getStats() const override {
+        stats.bytesOut = inner->getStats().bytesOut;
+        return stats;
+    }
+
+protected:
+    bool put(const void* data, size_t size) {
+        if (ok && size > 0) {
+            ok = inner->write(static_cast<const char*>(data), size);
+        }
+        return ok;
+    }
+
+    bool finishInner() {
+        if (!innerFinished) {
+            ok = inner->finish() && ok;
+            innerFinished = true;
+        }
+        return ok;
+    }
+
+    std::unique_ptr<OutputSink> inner;
+    mutable Stats stats;
+    bool ok = true;
+
+private:
+    bool innerFinished = false;
+};
+
+class GzipSink : public EncoderSink {
+public:
+    GzipSink(std::unique_ptr<OutputSink> inner, int level)
+        : EncoderSink(std::move(inner)), buffer(1 << 16) {
+        // 15 window bits + 16 selects the gzip wrapper instead of raw zlib
+        ready = deflateInit2(&stream, level == 0 ? Z_DEFAULT_COMPRESSION : level,
+            Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        ok = ready;
+    }
+
+    ~GzipSink() override {
+        if (ready) {
+            deflateEnd(&stream);
+        }
+    }
+
+    bool write(const char* data, size_t size) override {
+        stats.bytesIn += size;
+        while (ok && size > 0) {
+            // avail_in is 32-bit; feed very large writes in slices
+            uInt slice = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            stream.avail_in = slice;
+            deflateAll(Z_NO_FLUSH);
+            data += slice;
+            size -= slice;
+        }
+        return ok;
+    }
+
+    bool finish() override {
+        if (ready) {
+            stream.next_in = nullptr;
+            stream.avail_in = 0;
+            deflateAll(Z_FINISH);
+            deflateEnd(&stream);
+            ready = false;
+        }
+        return finishInner();
+    }
+
+private:
+    void deflateAll(int flush) {
+        for (;;) {
+            stream.next_out = buffer.data();
+            stream.avail_out = static_cast<uInt>(buffer.size());
+            int status = deflate(&stream, flush);
+            if (status == Z_STREAM_ERROR) {
+                ok = false;
+                return;
+            }
+            if (!put(buffer.data(), buffer.size() - stream.avail_out)) {
+                return;
+            }
+            // Done once deflate stops filling the whole buffer
+            if (flush == Z_FINISH ? status == Z_STREAM_END : stream.avail_out != 0) {
+                return;
+            }
+        }
+    }
+
+    z_stream stream{};
+    std::vector<Bytef> buffer;
+    bool ready = false;
+};
+
+class ZstdSink : public EncoderSink {
+public:
+    ZstdSink(std::unique_ptr<OutputSink> inner, int level)
+        : EncoderSink(std::move(inner)), buffer(ZSTD_CStreamOutSize()) {
+        context = ZSTD_createCCtx();
+        ok = context != nullptr &&
+            !ZSTD_isError(ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel,
+                level == 0 ? ZSTD_CLEVEL_DEFAULT : level)) &&
+            !ZSTD_isError(ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1));
+    }
+
+    ~ZstdSink() override {
+        ZSTD_freeCCtx(context);
+    }
+
+    bool write(const char* data, size_t size) override {
+        stats.bytesIn += size;
+        ZSTD_inBuffer input = {data, size, 0};
+        while (ok && input.pos < input.size) {
+            ZSTD_outBuffer output = {buffer.data(), buffer.size(), 0};
+            size_t status = ZSTD_compressStream2(context, &output, &input, ZSTD_e_continue);
+            ok = !ZSTD_isError(status) && put(buffer.data(), output.pos);
+        }
+        return ok;
+    }
+
+    bool finish() override {
+        if (context && !finished) {
+            ZSTD_inBuffer input = {nullptr, 0, 0};
+            size_t remaining = 1;
+            while (ok && remaining != 0) {
+                ZSTD_outBuffer output = {buffer.data(), buffer.size(), 0};
+                remaining = ZSTD_compressStream2(context, &output, &input, ZSTD_e_end);
+                ok = !ZSTD_isError(remaining) && put(buffer.data(), output.pos);
+            }
+            finished = true;
+        }
+        return finishInner();
+    }
+
+private:
+    ZSTD_CCtx* context = nullptr;
+    std::vector<char> buffer;
+    bool finished = false;
+};
+
+// Runs another sink on a dedicated thread. The caller fills one buffer while
+// the thread drains the other; a full buffer waits only if the thread is
+// still busy with the previous one.
+class ThreadedSink : public OutputSink {
+public:
+    ThreadedSink(std::unique_ptr<OutputSink> inner, size_t bufferBytes)
+        : inner(std::move(inner)), bufferBytes(std::max<size_t>(bufferBytes, 4096)) {
+        filling.reserve(this->bufferBytes);
+        pending.reserve(this->bufferBytes);
+        worker = std::thread([this] { drain(); });
+    }
+
+    ~ThreadedSink() override {
+        finish();
+    }
+
+    bool write(const char* data, size_t size) override {
+        stats.bytesIn += size;
+        filling.insert(filling.end(), data, data + size);
+        if (filling.size() >= bufferBytes) {
+            return handOff();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        return !failed;
+    }
+
+    bool finish() override {
+        if (!worker.joinable()) {
+            return !failed;
+        }
+        handOff();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        changed.notify_all();
+        worker.join();
+
+        failed = !inner->finish() || failed;
+        stats.bytesOut = inner->getStats().bytesOut;
+        return !failed;
+    }
+
+    const Stats& getStats() const override { return stats; }
+
+private:
+    bool handOff() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !pendingFull; });
+        if (failed) {
+            return false;
+        }
+        if (!filling.empty()) {
+            std::swap(filling, pending);  // filling gets the drained buffer back
+            pendingFull = true;
+            changed.notify_all();
+        }
+        return true;
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            changed.wait(lock, [this] { return pendingFull || done; });
+            if (!pendingFull) {
+                return;
+            }
+            lock.unlock();
+            bool ok = inner->write(pending.data(), pending.size());
+            pending.clear();
+            lock.lock();
+            failed = failed || !ok;
+            pendingFull = false;
+            changed.notify_all();
+        }
+    }
+
+    std::unique_ptr<OutputSink> inner;
+    const size_t bufferBytes;
+    std::vector<char> filling;
+    std::vector<char> pending;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool pendingFull = false;
+    bool done = false;
+    bool failed = false;
+    std::thread worker;
+
+    Stats stats;
+};
+
+// Puts the requested encoder, and its thread, in front of `end`
+std::unique_ptr<OutputSink> encode(std::unique_ptr<OutputSink> end, OutputSink::Compression compression,
+                                   const OutputSink::Options& options) {
+    std::unique_ptr<OutputSink> sink;
+    switch (compression) {
+        case OutputSink::Compression::Gzip:
+            sink = std::make_unique<GzipSink>(std::move(end), options.level);
+            break;
+        case OutputSink::Compression::Zstd:
+            sink = std::make_unique<ZstdSink>(std::move(end), options.level);
+            break;
+        default:
+            // Nothing to offload, so never threaded
+            return end;
+    }
+
+    if (options.compressionThread) {
+        sink = std::make_unique<ThreadedSink>(std::move(sink), options.bufferBytes);
+    }
+    return sink;
+}
+
+} // namespace
+
+OutputSink::Compression OutputSink::compressionForPath(const std::string& path) {
+    if (hasSuffix(path, ".gz")) {
+        return Compression::Gzip;
+    }
+    if (hasSuffix(path, ".zst")) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+const char* OutputSink::compressionName(Compression compression) {
+    switch (compression) {
+        case Compression::Gzip: return "gzip";
+        case Compression::Zstd: return "zstd";
+        case Compression::None: return "none";
+        default: return "auto";
+    }
+}
+
+std::unique_ptr<OutputSink> OutputSink::open(const std::string& path, const Options& options) {
+    Compression compression = options.compression;
+    if (compression == Compression::Auto) {
+        compression = compressionForPath(path);
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        log("Failed to open output file for writing: %s", path.c_str());
+        return nullptr;
+    }
+    return encode(std::make_unique<FileSink>(file), compression, options);
+}
+
+std::unique_ptr<OutputSink> OutputSink::toBuffer(std::string& buffer, const Options& options) {
+    return encode(std::make_unique<BufferSink>(buffer), options.compression, options);
+}
+
+std::unique_ptr<OutputSink> OutputSink::encodeTo(OutputSink& destination, const Options& options) {
+    return encode(std::make_unique<ForwardingSink>(destination), options.compression, options);
+}
@@ -0,0 +1,121 @@
+#include "page_arena.hpp"
+#include <algorithm>
+#include <optional>
+
+namespace {
+
+// Forwards to another resource and counts what passes through
+class CountingResource : public std::pmr::memory_resource {
+public:
+    explicit CountingResource(std::pmr::memory_resource* target) : target(target) {}
+
+    void setTarget(std::pmr::memory_resource* newTarget) { target = newTarget; }
+
+    size_t allocations = 0;
+    size_t bytes = 0;
+
+private:
+    void* do_allocate(size_t size, size_t alignment) override {
+        ++allocations;
+        bytes += size;
+        return target->allocate(size, alignment);
+    }
+
+    void do_deallocate(void* p, size_t size, size_t alignment) override {
+        target->deallocate(p, size, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* target;
+};
+
+// Pages in a row that must all fit a smaller block before the retained one
+// shrinks, so a single huge page does not pin its memory for the whole run
+const size_t kShrinkAfterPages = 16;
+
+} // namespace
+
+class PageArena::Impl {
+public:
+    Stats stats;
+    std::unique_ptr<std::byte[]> block;
+    size_t blockSize = 0;
+    size_t initialSize = 0;
+    size_t windowPages = 0;  // Pages released in the current shrink window
+    size_t windowPeak = 0;   // Largest of them
+
+    // The initial size doubled until a page of `bytes` fits with room to spare
+    size_t sizeFor(size_t bytes) const {
+        size_t size = initialSize;
+        while (size < bytes + bytes / 4) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    CountingResource upstream{std::pmr::new_delete_resource()};
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+    CountingResource front{nullptr};
+
+    void reset(size_t size) {
+        if (size != blockSize) {
+            arena.reset();
+            block.reset(new std::byte[size]);
+            blockSize = size;
+        }
+        arena.emplace(block.get(), blockSize, &upstream);
+        front.setTarget(&*arena);
+        stats.retainedBytes = blockSize;
+    }
+};
+
+PageArena::PageArena(size_t initialBytes) : pimpl(std::make_unique<Impl>()) {
+    pimpl->initialSize = std::max<size_t>(initialBytes, 4096);
+    pimpl->reset(pimpl->initialSize);
+}
+
+PageArena::~PageArena() = default;
+
+std::pmr::memory_resource* PageArena::resource() {
+    return &pimpl->front;
+}
+
+void PageArena::release() {
+    Impl& impl = *pimpl;
+    size_t pageBytes = impl.front.bytes;
+
+    impl.stats.releases++;
+    impl.stats.allocations += impl.front.allocations;
+    impl.stats.bytesAllocated += pageBytes;
+    impl.stats.peakPageBytes = std::max(impl.stats.peakPageBytes, pageBytes);
+    impl.stats.upstreamAllocations += impl.upstream.allocations;
+    impl.stats.upstreamBytes += impl.upstream.bytes;
+
+    bool overflowed = impl.upstream.allocations > 0;
+    impl.front.allocations = impl.front.bytes = 0;
+    impl.upstream.allocations = impl.upstream.bytes = 0;
+
+    // Hands overflow blocks back to the heap in one go
+    impl.arena->release();
+
+    // Grow the retained block so a page like this one fits without the heap,
+    // and shrink it again once a run of pages has needed much less
+    impl.windowPeak = std::max(impl.windowPeak, pageBytes);
+    if (overflowed) {
+        impl.reset(impl.sizeFor(pageBytes));
+        impl.windowPages = impl.windowPeak = 0;
+    } else if (++impl.windowPages >= kShrinkAfterPages) {
+        size_t fit = impl.sizeFor(impl.windowPeak);
+        if (fit < impl.blockSize) {
+            impl.reset(fit);
+        }
+        impl.windowPages = impl.windowPeak = 0;
+    }
+}
+
+const PageArena::Stats& PageArena::getStats() const {
+    return pimpl->stats;
+}
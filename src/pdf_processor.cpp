@@ -1,51 +1,136 @@
 #include "pdf_processor.hpp"
+#include "geometry_kernels.hpp"
+#include "page_arena.hpp"
+#include "image_extractor.hpp"
+#include "document_model.hpp"
+#include "log.hpp"
+#include "document_model.pb.h"
 #include "poppler-document.h"
 #include "poppler-page.h"
 #include "poppler-page-renderer.h"
 #include <locale>
 #include <codecvt>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+
+namespace {
+
+// Lowest render scale a page is retraced at (9 DPI), whatever
+// PageBudget::minRenderScale says, so halving always ends
+const double kMinTraceScale = 0.125;
+
+// Emits one line per segment of a path already transformed to drawing units
+void processPath(const double* xy, size_t count, bool closed, double thickness, int page,
+                 std::vector<PDFProcessor::VectorElement>& out) {
+    using VectorElement = PDFProcessor::VectorElement;
+    if (count < 2) return;
+
+    // Convert path to line segments
+    for (size_t i = 1; i < count; ++i) {
+        VectorElement line;
+        line.type = VectorElement::Type::LINE;
+        line.points = {
+            xy[2 * (i - 1)], xy[2 * (i - 1) + 1],
+            xy[2 * i], xy[2 * i + 1]
+        };
+        line.thickness = thickness;
+        line.page = page;
+        out.push_back(line);
+    }
+
+    // Close the path if it's a closed contour
+    if (closed) {
+        VectorElement line;
+        line.type = VectorElement::Type::LINE;
+        line.points = {
+            xy[2 * (count - 1)], xy[2 * (count - 1) + 1],
+            xy[0], xy[1]
+        };
+        line.thickness = thickness;
+        line.page = page;
+        out.push_back(line);
+    }
+}
 
-// Forward declaration of the log function
-extern void log(const char* format, ...);
+} // namespace
 
 class PDFProcessor::Impl {
 public:
     std::unique_ptr<poppler::document> doc;
     std::vector<VectorElement> vectorElements;
     std::vector<std::string> textElements;
+    std::vector<ImageElement> imageElements;  // In page order, page rasters first
+    std::vector<int> textPages;  // Source page of each text element
+    std::vector<PageReport> pageReports;
+    std::string sourcePath;
+    // Set instead of sourcePath when the document was loaded from memory
+    const char* sourceData = nullptr;
+    size_t sourceSize = 0;
+    std::vector<double> pageOffsets;
+
+    Options options;
+
+    // Adds one page's images in page order, whichever of extractVectors()
+    // and extractImages() runs first. Page rasters go ahead of the page's
+    // embedded images so those are drawn on top.
+    void addPageImages(const std::vector<ImageElement>& images, bool rasters) {
+        if (images.empty()) {
+            return;
+        }
+        int page = images.front().page;
+        auto byPage = [](const ImageElement& image, int p) { return image.page < p; };
+        auto at = rasters ?
+            std::lower_bound(imageElements.begin(), imageElements.end(), page, byPage) :
+            std::upper_bound(imageElements.begin(), imageElements.end(), page,
+                [](int p, const ImageElement& image) { return p < image.page; });
+        imageElements.insert(at, images.begin(), images.end());
+    }
 
-    void processPath(const std::vector<cv::Point>& contour, double scale) {
-        if (contour.size() < 2) return;
-
-        // Convert contour to line segments
-        for (size_t i = 1; i < contour.size(); ++i) {
-            VectorElement line;
-            line.type = VectorElement::Type::LINE;
-            line.points = {
-                static_cast<double>(contour[i-1].x) / scale,
-                static_cast<double>(contour[i-1].y) / scale,
-                static_cast<double>(contour[i].x) / scale,
-                static_cast<double>(contour[i].y) / scale
-            };
-            line.thickness = 1.0;
-            vectorElements.push_back(line);
+    // Pages are laid out left to right in the drawing; this is each page's X
+    // offset in mm
+    const std::vector<double>& getPageOffsets() {
+        if (pageOffsets.empty() && doc) {
+            double offset = 0.0;
+            for (int i = 0; i < doc->pages(); ++i) {
+                pageOffsets.push_back(offset);
+                std::unique_ptr<poppler::page> page(doc->create_page(i));
+                if (page) {
+                    offset += page->page_rect().width() * geometry::kPointsToMillimeters + options.pageGap;
+                }
+            }
         }
+        return pageOffsets;
+    }
 
-        // Close the path if it's a closed contour
-        if (cv::norm(contour.front() - contour.back()) < 2.0) {
-            VectorElement line;
-            line.type = VectorElement::Type::LINE;
-            line.points = {
-                static_cast<double>(contour.back().x) / scale,
-                static_cast<double>(contour.back().y) / scale,
-                static_cast<double>(contour.front().x) / scale,
-                static_cast<double>(contour.front().y) / scale
-            };
-            line.thickness = 1.0;
-            vectorElements.push_back(line);
+    void describeDocument() {
+        int pageCount = doc->pages();
+        log("Successfully loaded PDF with %d pages", pageCount);
+
+        // Log PDF metadata if available
+        log("PDF is %s", doc->is_encrypted() ? "encrypted" : "not encrypted");
+        log("PDF is %s", doc->is_linearized() ? "linearized" : "not linearized");
+
+        if (pageCount == 0) {
+            log("Warning: PDF has no pages");
+        } else {
+            // Log information about the first page
+            std::unique_ptr<poppler::page> firstPage(doc->create_page(0));
+            if (firstPage) {
+                poppler::rectf pageSize = firstPage->page_rect();
+                log("First page size: %.2f x %.2f points", pageSize.width(), pageSize.height());
+            }
         }
     }
+
+    // Scratch for the page being processed, released once its elements are committed
+    PageArena pageArena;
+    // Created on first use from the options; kept across pages so backends
+    // can reuse their buffers
+    std::unique_ptr<RasterVectorizer> vectorizer;
 };
 
 PDFProcessor::PDFProcessor() : pimpl(std::make_unique<Impl>()) {
@@ -54,6 +139,16 @@ PDFProcessor::PDFProcessor() : pimpl(std::make_unique<Impl>()) {
 
 PDFProcessor::~PDFProcessor() = default;
 
+void PDFProcessor::setOptions(const Options& options) {
+    pimpl->options = options;
+    pimpl->pageOffsets.clear();
+    pimpl->vectorizer.reset();
+}
+
+const PDFProcessor::Options& PDFProcessor::getOptions() const {
+    return pimpl->options;
+}
+
 bool PDFProcessor::loadPDF(const std::string& filepath) {
     try {
         log("Attempting to load PDF: %s", filepath.c_str());
@@ -90,30 +185,52 @@ bool PDFProcessor::loadPDF(const std::string& filepath) {
         // Try to load the PDF
         log("File exists and is valid PDF, attempting to load with Poppler...");
         pimpl->doc.reset(poppler::document::load_from_file(filepath));
+        pimpl->sourcePath = filepath;
+        pimpl->sourceData = nullptr;
+        pimpl->sourceSize = 0;
+        pimpl->pageOffsets.clear();
         
         if (!pimpl->doc) {
             log("Failed to load PDF document: Poppler returned null document");
             return false;
         }
 
-        int pageCount = pimpl->doc->pages();
-        log("Successfully loaded PDF with %d pages", pageCount);
+        pimpl->describeDocument();
+        return true;
+    } catch (const std::exception& e) {
+        log("Exception while loading PDF: %s", e.what());
+        return false;
+    } catch (...) {
+        log("Unknown exception while loading PDF");
+        return false;
+    }
+}
 
-        // Log PDF metadata if available
-        log("PDF is %s", pimpl->doc->is_encrypted() ? "encrypted" : "not encrypted");
-        log("PDF is %s", pimpl->doc->is_linearized() ? "linearized" : "not linearized");
+bool PDFProcessor::loadPDFFromMemory(const char* data, size_t size) {
+    try {
+        log("Attempting to load PDF from memory: %zu bytes", size);
+        if (size < 4 || strncmp(data, "%PDF", 4) != 0) {
+            log("Error: Invalid PDF signature");
+            return false;
+        }
+        if (size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+            log("Error: PDF data too large to load from memory");
+            return false;
+        }
 
-        if (pageCount == 0) {
-            log("Warning: PDF has no pages");
-        } else {
-            // Log information about the first page
-            std::unique_ptr<poppler::page> firstPage(pimpl->doc->create_page(0));
-            if (firstPage) {
-                poppler::rectf pageSize = firstPage->page_rect();
-                log("First page size: %.2f x %.2f points", pageSize.width(), pageSize.height());
-            }
+        // Poppler parses the caller's bytes in place rather than copying them
+        pimpl->doc.reset(poppler::document::load_from_raw_data(data, static_cast<int>(size)));
+        pimpl->sourcePath.clear();
+        pimpl->sourceData = data;
+        pimpl->sourceSize = size;
+        pimpl->pageOffsets.clear();
+
+        if (!pimpl->doc) {
+            log("Failed to load PDF document: Poppler returned null document");
+            return false;
         }
 
+        pimpl->describeDocument();
         return true;
     } catch (const std::exception& e) {
         log("Exception while loading PDF: %s", e.what());
@@ -136,11 +253,16 @@ bool PDFProcessor::extractVectors() {
         log("Processing %d pages for vector elements", pageCount);
 
         poppler::page_renderer renderer;
-        renderer.set_render_hints(
-            poppler::page_renderer::antialiasing |
-            poppler::page_renderer::text_antialiasing |
-            poppler::page_renderer::text_hinting
-        );
+        setRenderHints(renderer);
+
+        if (!pimpl->vectorizer) {
+            pimpl->vectorizer = RasterVectorizer::create(
+                pimpl->options.vectorizer, pimpl->options.vectorizerOptions);
+        }
+        log("Vectorizer backend: %s", RasterVectorizer::backendName(pimpl->options.vectorizer));
+
+        const std::vector<double>& pageOffsets = pimpl->getPageOffsets();
+        geometry::Extents drawingExtents;
 
         for (int i = 0; i < pageCount; ++i) {
             log("Processing page %d for vectors...", i + 1);
@@ -155,46 +277,51 @@ bool PDFProcessor::extractVectors() {
             log("Page %d size: %.2f x %.2f points", i + 1, pageSize.width(), pageSize.height());
 
             // Render page at high resolution for vector detection
-            double scale = 4.0;  // Render at 4x resolution for better edge detection
-            poppler::image img = renderer.render_page(page.get(), 
-                72.0 * scale, 72.0 * scale);  // 72 DPI * scale
-
-            if (!img.is_valid()) {
+            double scale = pimpl->options.renderScale;  // Render at 4x resolution by default for better edge detection
+            auto renderStart = std::chrono::steady_clock::now();
+            cv::Mat gray;
+            if (!renderPageGray(renderer, *page, scale, gray)) {
                 log("Failed to render page %d", i + 1);
                 continue;
             }
-
-            // Convert to OpenCV format for processing
-            cv::Mat image(img.height(), img.width(), CV_8UC4, 
-                const_cast<char*>(img.const_data()));
-            
-            // Convert to grayscale
-            cv::Mat gray;
-            cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
-
-            // Edge detection
-            cv::Mat edges;
-            cv::Canny(gray, edges, 50, 150);
-
-            // Find contours
-            std::vector<std::vector<cv::Point>> contours;
-            cv::findContours(edges, contours, cv::RETR_LIST, 
-                cv::CHAIN_APPROX_TC89_KCOS);
-
-            log("Found %zu potential vector paths", contours.size());
-
-            // Process each contour
-            for (const auto& contour : contours) {
-                if (contour.size() >= 2) {  // Only process paths with at least 2 points
-                    pimpl->processPath(contour, scale);
-                }
+            double renderSeconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - renderStart).count();
+
+            // Trace paths within the page budget; they live in the page arena until committed
+            geometry::Extents pageExtents;
+            std::vector<ImageElement> rasters;
+            PageReport report = tracePage(gray, i, pageSize.height(), pageOffsets[i], renderSeconds,
+                pimpl->options, *pimpl->vectorizer, pimpl->pageArena,
+                pimpl->vectorElements, rasters, pageExtents);
+            pimpl->addPageImages(rasters, true);
+            pimpl->pageReports.push_back(report);
+
+            if (pageExtents.isValid()) {
+                log("Page %d extents: (%.2f,%.2f) - (%.2f,%.2f) mm", i + 1,
+                    pageExtents.minX, pageExtents.minY, pageExtents.maxX, pageExtents.maxY);
+                drawingExtents.merge(pageExtents);
             }
 
-            log("Processed %zu vector paths on page %d", contours.size(), i + 1);
+            log("Processed %zu vector paths on page %d", report.paths, i + 1);
         }
         
         log("Vector extraction complete. Found %zu vector elements", 
             pimpl->vectorElements.size());
+        size_t degraded = std::count_if(pimpl->pageReports.begin(), pimpl->pageReports.end(),
+            [](const PageReport& report) { return report.outcome != PageReport::Outcome::Full; });
+        if (degraded > 0) {
+            log("%zu of %zu pages exceeded their budget and were degraded",
+                degraded, pimpl->pageReports.size());
+        }
+        const PageArena::Stats& arenaStats = pimpl->pageArena.getStats();
+        log("Page arena: %zu allocations, %zu bytes over %zu trace attempts of %zu pages, "
+            "peak attempt %zu bytes, %zu heap fallbacks",
+            arenaStats.allocations, arenaStats.bytesAllocated, arenaStats.releases,
+            pimpl->pageReports.size(), arenaStats.peakPageBytes, arenaStats.upstreamAllocations);
+        if (drawingExtents.isValid()) {
+            log("Drawing extents: (%.2f,%.2f) - (%.2f,%.2f) mm",
+                drawingExtents.minX, drawingExtents.minY, drawingExtents.maxX, drawingExtents.maxY);
+        }
         return true;
     } catch (const std::exception& e) {
         log("Exception while extracting vectors: %s", e.what());
@@ -225,6 +352,213 @@ std::string utf16_to_utf8(const std::wstring& utf16) {
     }
 }
 
+void PDFProcessor::setRenderHints(poppler::page_renderer& renderer) {
+    renderer.set_render_hints(
+        poppler::page_renderer::antialiasing |
+        poppler::page_renderer::text_antialiasing |
+        poppler::page_renderer::text_hinting
+    );
+}
+
+bool PDFProcessor::renderPageGray(poppler::page_renderer& renderer, poppler::page& page,
+                                  double renderScale, cv::Mat& gray) {
+    poppler::image img = renderer.render_page(&page,
+        72.0 * renderScale, 72.0 * renderScale);  // 72 DPI * scale
+    if (!img.is_valid()) {
+        return false;
+    }
+
+    // Wrap the ARGB32 pixels for OpenCV and reduce to grayscale
+    cv::Mat image(img.height(), img.width(), CV_8UC4,
+        const_cast<char*>(img.const_data()));
+    cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    return true;
+}
+
+void PDFProcessor::commitPagePaths(RasterPaths& paths, const geometry::Transform& transform,
+                                   double quantizationGrid, int page,
+                                   std::vector<VectorElement>& out, geometry::Extents& extents) {
+    geometry::transformPoints(paths.coords.data(), paths.pointCount(), transform,
+        quantizationGrid, &extents);
+
+    // Every segment plus a possible closing segment per path
+    out.reserve(out.size() + paths.pointCount());
+    const double millimetersPerPixel = std::abs(transform.sx);
+    for (size_t p = 0; p < paths.pathCount(); ++p) {
+        processPath(paths.coords.data() + 2 * paths.starts[p],
+            paths.starts[p + 1] - paths.starts[p], paths.closed[p] != 0,
+            paths.widths[p] * millimetersPerPixel, page, out);
+    }
+}
+
+PDFProcessor::PageReport PDFProcessor::tracePage(const cv::Mat& gray, int page, double heightPoints,
+                                                 double offsetX, double renderSeconds,
+                                                 const Options& options, RasterVectorizer& vectorizer,
+                                                 PageArena& arena, std::vector<VectorElement>& vectors,
+                                                 std::vector<ImageElement>& images,
+                                                 geometry::Extents& extents) {
+    using Clock = std::chrono::steady_clock;
+    const PageBudget& budget = options.budget;
+    const Clock::time_point start = Clock::now();
+    auto elapsed = [&] {
+        return renderSeconds + std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    auto outOfTime = [&] { return budget.maxSeconds > 0.0 && elapsed() > budget.maxSeconds; };
+
+    // Pathological pages stop tracing at the first limit instead of running
+    // to completion before the budget is even looked at
+    RasterVectorizer::Limits limits;
+    limits.maxPaths = budget.maxPaths;
+    if (budget.maxSeconds > 0.0) {
+        limits.deadline = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(std::max(0.0, budget.maxSeconds - renderSeconds)));
+    }
+
+    // Halving stops here even if the budget asks for less (or for 0)
+    const double minScale = std::max(budget.minRenderScale, kMinTraceScale);
+
+    PageReport report;
+    report.page = page;
+    double scale = options.renderScale;
+    cv::Mat reduced;  // The page at `scale` once that is below the render scale
+    bool traced = false;
+    bool givenUp = false;
+
+    // One arena release per attempt, once its paths are gone
+    for (int attempt = 0; !traced && !givenUp; ++attempt) {
+        const cv::Mat& image = reduced.empty() ? gray : reduced;
+        {
+            RasterPaths paths(arena.resource());
+            // Rendering alone may have used up the time
+            bool finished = !outOfTime() && vectorizer.vectorize(image, paths, limits);
+            if (attempt == 0) {
+                report.paths = paths.pathCount();
+            }
+
+            // Simplifying is the cheapest fix, so it is tried in place first
+            std::string over;
+            if (budget.maxPaths > 0 && paths.pathCount() > budget.maxPaths) {
+                over = "paths";
+            } else if (!finished) {
+                over = "time";
+            } else if (budget.maxEntities > 0 && paths.segmentCount() > budget.maxEntities) {
+                paths.simplify(budget.simplifyTolerance);
+                if (paths.segmentCount() > budget.maxEntities) {
+                    over = "entities";
+                } else if (report.outcome == PageReport::Outcome::Full) {
+                    report.outcome = PageReport::Outcome::Simplified;
+                    report.reason = "entities";
+                }
+            }
+            if (report.reason.empty()) {
+                report.reason = over;
+            }
+            // Out of time for another attempt as well
+            if (!over.empty() && outOfTime()) {
+                over = "time";
+            }
+
+            if (over.empty()) {
+                geometry::Transform transform = geometry::makePageTransform(
+                    heightPoints, scale, offsetX, 0.0);
+                size_t before = vectors.size();
+                commitPagePaths(paths, transform, options.quantizationGrid, page, vectors, extents);
+                report.entities = vectors.size() - before;
+                traced = true;
+            } else if (over == "time" || scale / 2.0 < minScale) {
+                givenUp = true;
+            }
+        }
+        arena.release();
+
+        if (!traced && !givenUp) {
+            scale /= 2.0;
+            cv::resize(gray, reduced, cv::Size(), scale / options.renderScale,
+                scale / options.renderScale, cv::INTER_AREA);
+            report.outcome = PageReport::Outcome::LowerResolution;
+        }
+    }
+
+    if (traced) {
+        report.renderScale = scale;
+    } else if (!budget.rasterFallback) {
+        report.outcome = PageReport::Outcome::Failed;
+        report.entities = 0;
+    } else {
+        // Last resort: the page as an image, at a resolution that is cheap to keep
+        report.renderScale = std::min(budget.rasterScale, options.renderScale);
+        cv::Mat pixels;
+        if (report.renderScale < options.renderScale) {
+            double factor = report.renderScale / options.renderScale;
+            cv::resize(gray, pixels, cv::Size(), factor, factor, cv::INTER_AREA);
+        } else {
+            pixels = gray;
+        }
+
+        std::filesystem::path directory(options.imageDirectory);
+        std::filesystem::path target = directory / ("page_" + std::to_string(page + 1) + ".png");
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        if (!ec && cv::imwrite(target.string(), pixels)) {
+            const double mmPerPixel = geometry::kPointsToMillimeters / report.renderScale;
+            ImageElement raster;
+            raster.path = target.string();
+            raster.pixelWidth = pixels.cols;
+            raster.pixelHeight = pixels.rows;
+            raster.x = offsetX;
+            raster.y = 0.0;
+            raster.uX = mmPerPixel;
+            raster.uY = 0.0;
+            raster.vX = 0.0;
+            raster.vY = mmPerPixel;
+            raster.page = page;
+            images.push_back(raster);
+
+            double corners[] = {offsetX, 0.0, offsetX + pixels.cols * mmPerPixel, pixels.rows * mmPerPixel};
+            geometry::accumulateExtents(corners, 2, extents);
+            report.outcome = PageReport::Outcome::Raster;
+            report.entities = 1;
+        } else {
+            log("Failed to write raster fallback for page %d to %s", page + 1, target.string().c_str());
+            report.outcome = PageReport::Outcome::Failed;
+        }
+    }
+
+    report.seconds = elapsed();
+    if (report.outcome != PageReport::Outcome::Full) {
+        log("Page %d over its %s budget: %s at %.2fx, %zu paths traced first, %zu entities kept, %.2f s",
+            page + 1, report.reason.c_str(), outcomeName(report.outcome), report.renderScale,
+            report.paths, report.entities, report.seconds);
+    }
+    return report;
+}
+
+const char* PDFProcessor::outcomeName(PageReport::Outcome outcome) {
+    switch (outcome) {
+        case PageReport::Outcome::Simplified: return "simplified";
+        case PageReport::Outcome::LowerResolution: return "lower resolution";
+        case PageReport::Outcome::Raster: return "raster";
+        case PageReport::Outcome::Failed: return "failed";
+        default: return "full";
+    }
+}
+
+std::string PDFProcessor::pageText(poppler::page& page) {
+    // Get text as a byte array
+    poppler::byte_array text_data = page.text().to_utf8();
+    std::string text(text_data.begin(), text_data.end());
+
+    // Clean up text - replace control characters with spaces
+    for (char& c : text) {
+        if (c < 32 && c != '\n' && c != '\r' && c != '\t') {
+            c = ' ';
+        }
+    }
+
+    // Round trip through UTF-16 to handle UTF-8 text properly
+    return text.empty() ? text : utf16_to_utf8(utf8_to_utf16(text));
+}
+
 bool PDFProcessor::extractText() {
     if (!pimpl->doc) {
         log("Cannot extract text: No PDF loaded");
@@ -245,35 +579,17 @@ bool PDFProcessor::extractText() {
                 continue;
             }
 
-            // Get text as a byte array
             log("Extracting text from page %d...", i + 1);
-            poppler::byte_array text_data = page->text().to_utf8();
-            
-            // Convert byte array to string
-            if (text_data.size() > 0) {
-                std::string text(reinterpret_cast<const char*>(text_data.data()), text_data.size());
-                if (!text.empty()) {
-                    // Clean up text - replace control characters with spaces
-                    for (char& c : text) {
-                        if (c < 32 && c != '\n' && c != '\r' && c != '\t') {
-                            c = ' ';
-                        }
-                    }
-                    
-                    // Try to handle UTF-8 text properly
-                    std::wstring wtext = utf8_to_utf16(text);
-                    std::string cleaned_text = utf16_to_utf8(wtext);
-                    
-                    log("Found text on page %d (%zu bytes)", i + 1, text.length());
-                    log("Text preview (first 100 chars): %s", 
-                        cleaned_text.substr(0, std::min(size_t(100), cleaned_text.length())).c_str());
-                    
-                    pimpl->textElements.push_back(cleaned_text);
-                } else {
-                    log("No text found on page %d (empty string)", i + 1);
-                }
+            std::string text = pageText(*page);
+            if (!text.empty()) {
+                log("Found text on page %d (%zu bytes)", i + 1, text.length());
+                log("Text preview (first 100 chars): %s",
+                    text.substr(0, std::min(size_t(100), text.length())).c_str());
+
+                pimpl->textElements.push_back(text);
+                pimpl->textPages.push_back(i);
             } else {
-                log("No text data on page %d (zero bytes)", i + 1);
+                log("No text found on page %d", i + 1);
             }
         }
 
@@ -294,14 +610,184 @@ bool PDFProcessor::extractImages() {
         return false;
     }
 
-    log("Image extraction not implemented yet");
-    return true;
+    try {
+        log("Starting image extraction into %s...", pimpl->options.imageDirectory.c_str());
+        ImageExtractor extractor(pimpl->options.imageDirectory);
+        bool opened = pimpl->sourceData ?
+            extractor.open(pimpl->sourceData, pimpl->sourceSize) :
+            extractor.open(pimpl->sourcePath);
+        if (!opened) {
+            return false;
+        }
+
+        const std::vector<double>& pageOffsets = pimpl->getPageOffsets();
+        const double k = geometry::kPointsToMillimeters;
+        int pageCount = pimpl->doc->pages();
+        std::vector<ImageExtractor::Placement> placements;
+        std::vector<ImageElement> pageImages;
+
+        for (int i = 0; i < pageCount; ++i) {
+            placements.clear();
+            if (!extractor.extractPage(i, placements)) {
+                log("Warning: Failed to extract images from page %d", i + 1);
+                continue;
+            }
+
+            // Page points to drawing millimetres, same layout as the vectors
+            pageImages.clear();
+            for (const auto& placement : placements) {
+                ImageElement image;
+                image.path = placement.path;
+                image.pixelWidth = placement.pixelWidth;
+                image.pixelHeight = placement.pixelHeight;
+                image.x = placement.x * k + pageOffsets[i];
+                image.y = placement.y * k;
+                image.uX = placement.uX * k;
+                image.uY = placement.uY * k;
+                image.vX = placement.vX * k;
+                image.vY = placement.vY * k;
+                image.page = i;
+                pageImages.push_back(image);
+            }
+            pimpl->addPageImages(pageImages, false);
+            if (!placements.empty()) {
+                log("Found %zu image placements on page %d", placements.size(), i + 1);
+            }
+        }
+
+        const ImageExtractor::Stats& stats = extractor.getStats();
+        log("Image extraction complete. %zu placements, %zu files written (%zu passed through), "
+            "%zu repeats by reference, %zu by content, %zu failed",
+            stats.placements, stats.uniqueImages, stats.passedThrough,
+            stats.dedupedByRef, stats.dedupedByHash, stats.failed);
+        return true;
+    } catch (const std::exception& e) {
+        log("Exception while extracting images: %s", e.what());
+        return false;
+    } catch (...) {
+        log("Unknown exception while extracting images");
+        return false;
+    }
+}
+
+bool PDFProcessor::exportModel(const std::string& path) {
+    if (!pimpl->doc) {
+        log("Cannot export model: No PDF loaded");
+        return false;
+    }
+
+    try {
+        auto utf8 = [](const poppler::ustring& text) {
+            poppler::byte_array bytes = text.to_utf8();
+            return std::string(bytes.begin(), bytes.end());
+        };
+
+        int pageCount = pimpl->doc->pages();
+        pdf2cad::model::DocumentHeader header;
+        header.set_page_count(static_cast<uint32_t>(pageCount));
+        pdf2cad::model::Metadata* metadata = header.mutable_metadata();
+        metadata->set_source_path(pimpl->sourcePath);
+        metadata->set_title(utf8(pimpl->doc->get_title()));
+        metadata->set_author(utf8(pimpl->doc->get_author()));
+        metadata->set_creator(utf8(pimpl->doc->get_creator()));
+        metadata->set_producer(utf8(pimpl->doc->get_producer()));
+        metadata->set_render_scale(pimpl->options.renderScale);
+        metadata->set_quantization_grid(pimpl->options.quantizationGrid);
+        metadata->set_page_gap(pimpl->options.pageGap);
+
+        DocumentModelWriter writer;
+        if (!writer.open(path, header)) {
+            return false;
+        }
+
+        // Elements are stored in page order, so each page is a contiguous run
+        const std::vector<double>& pageOffsets = pimpl->getPageOffsets();
+        const auto& vectors = pimpl->vectorElements;
+        const auto& texts = pimpl->textElements;
+        const auto& images = pimpl->imageElements;
+        size_t v = 0, t = 0, m = 0;
+        pdf2cad::model::Page page;
+
+        for (int i = 0; i < pageCount; ++i) {
+            page.Clear();
+            page.set_index(static_cast<uint32_t>(i));
+            page.set_offset_x(pageOffsets[i]);
+            std::unique_ptr<poppler::page> pdfPage(pimpl->doc->create_page(i));
+            if (pdfPage) {
+                poppler::rectf pageSize = pdfPage->page_rect();
+                page.set_width(pageSize.width() * geometry::kPointsToMillimeters);
+                page.set_height(pageSize.height() * geometry::kPointsToMillimeters);
+            }
+
+            for (; v < vectors.size() && vectors[v].page == i; ++v) {
+                pdf2cad::model::Entity* entity = page.add_entities();
+                entity->set_type(static_cast<pdf2cad::model::Entity::Type>(vectors[v].type));
+                entity->mutable_points()->Add(vectors[v].points.begin(), vectors[v].points.end());
+                entity->set_thickness(vectors[v].thickness);
+            }
+            for (; t < texts.size() && pimpl->textPages[t] == i; ++t) {
+                page.add_texts()->set_text(texts[t]);
+            }
+            for (; m < images.size() && images[m].page == i; ++m) {
+                const ImageElement& image = images[m];
+                pdf2cad::model::Image* out = page.add_images();
+                out->set_path(image.path);
+                out->set_pixel_width(image.pixelWidth);
+                out->set_pixel_height(image.pixelHeight);
+                out->set_x(image.x);
+                out->set_y(image.y);
+                out->set_u_x(image.uX);
+                out->set_u_y(image.uY);
+                out->set_v_x(image.vX);
+                out->set_v_y(image.vY);
+            }
+
+            if (!writer.writePage(page)) {
+                log("Failed to write page %d to model file", i + 1);
+                return false;
+            }
+        }
+
+        if (v != vectors.size() || t != texts.size() || m != images.size()) {
+            log("Elements out of page order; %zu vectors, %zu texts and %zu images not exported",
+                vectors.size() - v, texts.size() - t, images.size() - m);
+            return false;
+        }
+        if (!writer.close()) {
+            log("Failed to finish model file: %s", path.c_str());
+            return false;
+        }
+        log("Exported document model with %d pages to %s", pageCount, path.c_str());
+        return true;
+    } catch (const std::exception& e) {
+        log("Exception while exporting model: %s", e.what());
+        return false;
+    } catch (...) {
+        log("Unknown exception while exporting model");
+        return false;
+    }
+}
+
+const std::vector<double>& PDFProcessor::getPageOffsets() {
+    return pimpl->getPageOffsets();
 }
 
 const std::vector<PDFProcessor::VectorElement>& PDFProcessor::getVectorElements() const {
     return pimpl->vectorElements;
 }
 
+const std::vector<PDFProcessor::PageReport>& PDFProcessor::getPageReports() const {
+    return pimpl->pageReports;
+}
+
+const PageArena::Stats& PDFProcessor::getArenaStats() const {
+    return pimpl->pageArena.getStats();
+}
+
 const std::vector<std::string>& PDFProcessor::getTextElements() const {
     return pimpl->textElements;
+}
+
+const std::vector<PDFProcessor::ImageElement>& PDFProcessor::getImageElements() const {
+    return pimpl->imageElements;
 } 
\ No newline at end of file
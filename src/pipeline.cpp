@@ -0,0 +1,79 @@
+#include "pipeline.hpp"
+#include "log.hpp"
+#include <atomic>
+#include <exception>
+
+bool Pipeline::run() {
+    Clock::time_point start = Clock::now();
+    std::atomic<bool> failed{false};
+    std::mutex abortMutex;
+    auto abortAll = [&] {
+        std::lock_guard<std::mutex> lock(abortMutex);
+        for (const auto& stage : stages) {
+            if (stage->abortQueue) {
+                stage->abortQueue();
+            }
+        }
+        for (const auto& abortInput : abortInputs) {
+            abortInput();
+        }
+    };
+
+    std::vector<std::vector<Counters>> counters(stages.size());
+    std::vector<std::unique_ptr<std::atomic<unsigned>>> running;
+    std::vector<std::thread> threads;
+    for (size_t s = 0; s < stages.size(); ++s) {
+        counters[s].resize(stages[s]->workers);
+        running.push_back(std::make_unique<std::atomic<unsigned>>(stages[s]->workers));
+    }
+
+    for (size_t s = 0; s < stages.size(); ++s) {
+        for (unsigned w = 0; w < stages[s]->workers; ++w) {
+            threads.emplace_back([&, s, w] {
+                Stage& stage = *stages[s];
+                bool ok = false;
+                try {
+                    ok = stage.body(counters[s][w]);
+                } catch (const std::exception& e) {
+                    log("Pipeline stage '%s' threw: %s", stage.name.c_str(), e.what());
+                } catch (...) {
+                    log("Pipeline stage '%s' threw an unknown exception", stage.name.c_str());
+                }
+
+                if (!ok && !failed.exchange(true)) {
+                    log("Pipeline stage '%s' failed, cancelling", stage.name.c_str());
+                    abortAll();
+                }
+                // The last worker out tells the next stage no more input is coming
+                if (--*running[s] == 0 && stage.closeOutput) {
+                    stage.closeOutput();
+                }
+            });
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    stats.clear();
+    for (size_t s = 0; s < stages.size(); ++s) {
+        StageStats stage;
+        stage.name = stages[s]->name;
+        stage.workers = stages[s]->workers;
+        for (const Counters& c : counters[s]) {
+            stage.items += c.items;
+            stage.busySeconds += std::chrono::duration<double>(c.busy).count();
+            stage.starvedSeconds += std::chrono::duration<double>(c.starved).count();
+            stage.blockedSeconds += std::chrono::duration<double>(c.blocked).count();
+        }
+        if (stages[s]->outputStats) {
+            stages[s]->outputStats(stage);
+        }
+        if (wallSeconds > 0.0) {
+            stage.occupancy = stage.busySeconds / (stage.workers * wallSeconds);
+        }
+        stats.push_back(stage);
+    }
+    return !failed;
+}
@@ -0,0 +1,639 @@
+#include "raster_vectorizer.hpp"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Canny edges traced with findContours. Each stroke yields an outline per edge.
+// The contour and hierarchy vectors are members, so after the first page
+// findContours refills storage it already has instead of allocating anew.
+class ContourVectorizer : public RasterVectorizer {
+public:
+    bool vectorize(const cv::Mat& gray, RasterPaths& paths, const Limits& limits) override {
+        cv::Canny(gray, edges, 50, 150);
+        cv::findContours(edges, contours, hierarchy, cv::RETR_LIST, cv::CHAIN_APPROX_TC89_KCOS);
+        if (limits.reached(0)) {
+            return false;
+        }
+
+        size_t pointCount = 0;
+        for (const auto& contour : contours) {
+            pointCount += contour.size();
+        }
+        paths.coords.reserve(paths.coords.size() + 2 * pointCount);
+        const size_t firstPath = paths.pathCount();
+        for (const auto& contour : contours) {
+            if (contour.size() < 2) {  // Only paths with at least 2 points
+                continue;
+            }
+            if (limits.maxPaths > 0 && paths.pathCount() - firstPath >= limits.maxPaths) {
+                return false;
+            }
+            for (const auto& pt : contour) {
+                paths.addPoint(pt.x, pt.y);
+            }
+            paths.endPath(cv::norm(contour.front() - contour.back()) < 2.0);
+        }
+        return true;
+    }
+
+private:
+    // Kept across pages so Canny and findContours can reuse their buffers
+    cv::Mat edges;
+    std::vector<std::vector<cv::Point>> contours;
+    std::vector<cv::Vec4i> hierarchy;
+};
+
+// Straight segments from OpenCV's line segment detector, run on horizontal
+// bands in parallel. Detected pieces are then merged: pieces of one line
+// (split at band seams or by small gaps) join end to end, and the two edges
+// of a thin stroke collapse onto its centre line.
+class SegmentVectorizer : public RasterVectorizer {
+public:
+    explicit SegmentVectorizer(const Options& options) : options(options) {}
+
+    bool vectorize(const cv::Mat& gray, RasterPaths& paths, const Limits& limits) override {
+        std::vector<cv::Vec4f> segments;
+        if (!detect(gray, limits, segments)) {
+            return false;
+        }
+        merge(segments, paths);
+        return true;
+    }
+
+private:
+    struct Piece {
+        double theta;   // Direction in [-pi/4, 3pi/4), so near-horizontal lines never wrap
+        double rho;     // Offset along the normal
+        double t0, t1;  // Extent along the direction
+        double length;
+        size_t index;
+    };
+
+    // False when the deadline passed before every band was detected
+    bool detect(const cv::Mat& gray, const Limits& limits, std::vector<cv::Vec4f>& segments) const {
+        unsigned threads = options.threads;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const int minRows = std::max(1, options.minBandRows);
+        const int bandCount = std::max(1, std::min<int>(threads, gray.rows / minRows));
+        const int bandRows = (gray.rows + bandCount - 1) / bandCount;
+        // Overlap so lines near a seam are seen whole by at least one band
+        const int margin = static_cast<int>(std::ceil(options.distanceTolerance + options.gapBridge)) + 4;
+
+        std::vector<std::vector<cv::Vec4f>> found(bandCount);
+        std::atomic<int> nextBand{0};
+        std::atomic<bool> stopped{false};
+        auto worker = [&]() {
+            // The detector keeps per-image state, so one per thread
+            cv::Ptr<cv::LineSegmentDetector> detector = cv::createLineSegmentDetector(cv::LSD_REFINE_STD);
+            std::vector<cv::Vec4f> lines;
+            for (int band = nextBand++; band < bandCount; band = nextBand++) {
+                // Segments only become paths once merged, so time is the limit here
+                if (stopped || limits.reached(0)) {
+                    stopped = true;
+                    return;
+                }
+                int y0 = band * bandRows;
+                int y1 = std::min(gray.rows, y0 + bandRows);
+                int top = std::max(0, y0 - margin);
+                int bottom = std::min(gray.rows, y1 + margin);
+                lines.clear();
+                detector->detect(gray.rowRange(top, bottom), lines);
+
+                // Each band keeps the pieces centred inside it
+                for (cv::Vec4f line : lines) {
+                    line[1] += top;
+                    line[3] += top;
+                    float mid = 0.5f * (line[1] + line[3]);
+                    if (mid >= y0 && mid < y1) {
+                        found[band].push_back(line);
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < bandCount; ++t) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : workers) {
+            thread.join();
+        }
+
+        if (stopped) {
+            return false;
+        }
+        for (const auto& band : found) {
+            segments.insert(segments.end(), band.begin(), band.end());
+        }
+        return true;
+    }
+
+    // Positions a segment in the frame of direction `theta`
+    static void measure(const cv::Vec4f& s, double theta, Piece& piece) {
+        double c = std::cos(theta), sn = std::sin(theta);
+        double a = s[0] * c + s[1] * sn;
+        double b = s[2] * c + s[3] * sn;
+        piece.t0 = std::min(a, b);
+        piece.t1 = std::max(a, b);
+        piece.rho = 0.5 * ((s[1] + s[3]) * c - (s[0] + s[2]) * sn);
+    }
+
+    void merge(const std::vector<cv::Vec4f>& segments, RasterPaths& paths) const {
+        const double angleTolerance = options.angleTolerance * kPi / 180.0;
+
+        std::vector<Piece> pieces;
+        pieces.reserve(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const cv::Vec4f& s = segments[i];
+            Piece piece;
+            piece.theta = std::atan2(s[3] - s[1], s[2] - s[0]);
+            while (piece.theta < -kPi / 4) piece.theta += kPi;
+            while (piece.theta >= 3 * kPi / 4) piece.theta -= kPi;
+            piece.length = std::hypot(s[2] - s[0], s[3] - s[1]);
+            piece.index = i;
+            if (piece.length > 0.0) {
+                pieces.push_back(piece);
+            }
+        }
+        std::sort(pieces.begin(), pieces.end(),
+            [](const Piece& a, const Piece& b) { return a.theta < b.theta; });
+
+        // Runs of similar direction, then groups of similar offset within a
+        // run, then overlapping or nearly touching extents within a group
+        std::vector<const Piece*> members;
+        for (size_t runStart = 0; runStart < pieces.size();) {
+            size_t runEnd = runStart + 1;
+            while (runEnd < pieces.size() && pieces[runEnd].theta - pieces[runStart].theta <= angleTolerance) {
+                ++runEnd;
+            }
+
+            double weighted = 0.0, total = 0.0;
+            for (size_t i = runStart; i < runEnd; ++i) {
+                weighted += pieces[i].theta * pieces[i].length;
+                total += pieces[i].length;
+            }
+            double theta = weighted / total;
+            for (size_t i = runStart; i < runEnd; ++i) {
+                measure(segments[pieces[i].index], theta, pieces[i]);
+            }
+            std::sort(pieces.begin() + runStart, pieces.begin() + runEnd,
+                [](const Piece& a, const Piece& b) { return a.rho < b.rho; });
+
+            for (size_t groupStart = runStart; groupStart < runEnd;) {
+                size_t groupEnd = groupStart + 1;
+                while (groupEnd < runEnd &&
+                       pieces[groupEnd].rho - pieces[groupStart].rho <= options.distanceTolerance) {
+                    ++groupEnd;
+                }
+                std::sort(pieces.begin() + groupStart, pieces.begin() + groupEnd,
+                    [](const Piece& a, const Piece& b) { return a.t0 < b.t0; });
+
+                members.clear();
+                double reach = -HUGE_VAL;
+                for (size_t i = groupStart; i < groupEnd; ++i) {
+                    if (!members.empty() && pieces[i].t0 > reach + options.gapBridge) {
+                        emit(segments, members, paths);
+                        members.clear();
+                    }
+                    members.push_back(&pieces[i]);
+                    reach = std::max(reach, pieces[i].t1);
+                }
+                emit(segments, members, paths);
+                groupStart = groupEnd;
+            }
+            runStart = runEnd;
+        }
+    }
+
+    // Fits one segment through the members' endpoints, spanning all of them
+    void emit(const std::vector<cv::Vec4f>& segments, const std::vector<const Piece*>& members,
+              RasterPaths& paths) const {
+        double total = 0.0, cx = 0.0, cy = 0.0;
+        for (const Piece* piece : members) {
+            const cv::Vec4f& s = segments[piece->index];
+            total += piece->length;
+            cx += piece->length * 0.5 * (s[0] + s[2]);
+            cy += piece->length * 0.5 * (s[1] + s[3]);
+        }
+        cx /= total;
+        cy /= total;
+
+        double sxx = 0.0, sxy = 0.0, syy = 0.0;
+        for (const Piece* piece : members) {
+            const cv::Vec4f& s = segments[piece->index];
+            for (int e = 0; e < 2; ++e) {
+                double dx = s[2 * e] - cx, dy = s[2 * e + 1] - cy;
+                sxx += piece->length * dx * dx;
+                sxy += piece->length * dx * dy;
+                syy += piece->length * dy * dy;
+            }
+        }
+        double angle = 0.5 * std::atan2(2.0 * sxy, sxx - syy);
+        double c = std::cos(angle), sn = std::sin(angle);
+
+        double lo = HUGE_VAL, hi = -HUGE_VAL;
+        for (const Piece* piece : members) {
+            const cv::Vec4f& s = segments[piece->index];
+            for (int e = 0; e < 2; ++e) {
+                double t = (s[2 * e] - cx) * c + (s[2 * e + 1] - cy) * sn;
+                lo = std::min(lo, t);
+                hi = std::max(hi, t);
+            }
+        }
+        if (hi - lo < options.minLength) {
+            return;
+        }
+        paths.addPoint(cx + lo * c, cy + lo * sn);
+        paths.addPoint(cx + hi * c, cy + hi * sn);
+        paths.endPath(false);
+    }
+
+    Options options;
+};
+
+// Ink thinned to one-pixel centre lines with Zhang-Suen, then traced into
+// polylines, so a stroke yields one path however wide it is. The distance
+// from the centre line to the paper gives each path's stroke width.
+class CenterlineVectorizer : public RasterVectorizer {
+public:
+    explicit CenterlineVectorizer(const Options& options) : options(options) {
+        // Neighbours of a pixel as bits, clockwise from north:
+        //   7 0 1
+        //   6 . 2
+        //   5 4 3
+        for (unsigned m = 0; m < 256; ++m) {
+            int count = 0, runs = 0;
+            for (int b = 0; b < 8; ++b) {
+                count += (m >> b) & 1;
+                runs += !((m >> b) & 1) && ((m >> ((b + 1) & 7)) & 1);
+            }
+            auto has = [m](int b) { return ((m >> b) & 1) != 0; };
+            bool removable = count >= 2 && count <= 6 && runs == 1;
+            crossings[m] = static_cast<unsigned char>(runs);
+            removableFirst[m] = removable && !(has(0) && has(2) && has(4)) && !(has(2) && has(4) && has(6));
+            removableSecond[m] = removable && !(has(0) && has(2) && has(6)) && !(has(0) && has(4) && has(6));
+        }
+    }
+
+    bool vectorize(const cv::Mat& gray, RasterPaths& paths, const Limits& limits) override {
+        double lo = 0.0, hi = 0.0;
+        cv::minMaxLoc(gray, &lo, &hi);
+        if (lo == hi) {
+            return true;  // Blank page; Otsu would find ink anyway
+        }
+        if (options.inkThreshold > 0) {
+            cv::threshold(gray, ink, options.inkThreshold, 1, cv::THRESH_BINARY_INV);
+        } else {
+            cv::threshold(gray, ink, 0, 1, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+        }
+        // A paper border keeps every neighbourhood inside the image
+        cv::copyMakeBorder(ink, skeleton, 1, 1, 1, 1, cv::BORDER_CONSTANT, 0);
+        cv::distanceTransform(skeleton, distance, cv::DIST_L2, cv::DIST_MASK_5, CV_32F);
+
+        if (!thin(limits)) {
+            return false;
+        }
+        size_t firstPath = paths.pathCount();
+        if (!trace(paths, firstPath, limits)) {
+            return false;
+        }
+        paths.simplify(options.simplifyTolerance, firstPath);
+        return true;
+    }
+
+private:
+    unsigned neighbours(size_t i) const {
+        const unsigned char* p = skeleton.data + i;
+        const ptrdiff_t w = skeleton.cols;
+        return p[-w] | p[-w + 1] << 1 | p[1] << 2 | p[w + 1] << 3 |
+               p[w] << 4 | p[w - 1] << 5 | p[-1] << 6 | p[-w - 1] << 7;
+    }
+
+    // Runs body(begin, end) over [0, count) in equal chunks, one per thread
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) const {
+        unsigned threads = options.threads;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const size_t minChunk = 16384;  // Less is not worth a thread
+        const size_t chunks = std::max<size_t>(1, std::min<size_t>(threads, count / minChunk));
+        const size_t chunkSize = (count + chunks - 1) / chunks;
+        std::vector<std::thread> workers;
+        for (size_t c = 1; c < chunks; ++c) {
+            workers.emplace_back(body, c * chunkSize, std::min(count, (c + 1) * chunkSize));
+        }
+        body(0, std::min(count, chunkSize));
+        for (auto& thread : workers) {
+            thread.join();
+        }
+    }
+
+    // Zhang-Suen thinning. Only pixels on the edge of the ink can go, and a
+    // pixel kept by a pass stays kept by that pass until a neighbour goes. So
+    // each pass checks just the pixels next to what was removed since, instead
+    // of the whole page: work follows the shrinking edge, not the paper.
+    // False when the deadline passed between two passes.
+    bool thin(const Limits& limits) {
+        enum : unsigned char { Listed = 1, KeptFirst = 2, KeptSecond = 4 };
+        unsigned char* data = skeleton.data;
+        const size_t w = skeleton.cols;
+        state.create(skeleton.size(), CV_8U);
+        state.setTo(0);
+
+        candidates.clear();
+        for (size_t y = 1; y + 1 < static_cast<size_t>(skeleton.rows); ++y) {
+            for (size_t i = y * w + 1; i < (y + 1) * w - 1; ++i) {
+                if (data[i] && neighbours(i) != 0xFF) {
+                    candidates.push_back(i);
+                    state.data[i] = Listed;
+                }
+            }
+        }
+
+        const ptrdiff_t around[8] = {
+            -static_cast<ptrdiff_t>(w) - 1, -static_cast<ptrdiff_t>(w), -static_cast<ptrdiff_t>(w) + 1,
+            -1, 1,
+            static_cast<ptrdiff_t>(w) - 1, static_cast<ptrdiff_t>(w), static_cast<ptrdiff_t>(w) + 1
+        };
+        for (int pass = 0; !candidates.empty(); pass ^= 1) {
+            if (limits.reached(0)) {
+                return false;
+            }
+            const bool* removable = pass == 0 ? removableFirst : removableSecond;
+            const unsigned char kept = pass == 0 ? KeptFirst : KeptSecond;
+            // Every pixel is judged on the image as the pass found it
+            removed.resize(candidates.size());
+            parallelFor(candidates.size(), [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    size_t i = candidates[k];
+                    removed[k] = !(state.data[i] & kept) && removable[neighbours(i)];
+                }
+            });
+            for (size_t k = 0; k < candidates.size(); ++k) {
+                if (removed[k]) {
+                    data[candidates[k]] = 0;
+                } else {
+                    state.data[candidates[k]] |= kept;
+                }
+            }
+
+            next.clear();
+            for (size_t k = 0; k < candidates.size(); ++k) {
+                if (!removed[k]) {
+                    continue;
+                }
+                state.data[candidates[k]] = 0;
+                for (ptrdiff_t offset : around) {
+                    size_t j = candidates[k] + offset;
+                    if (data[j]) {
+                        if (!(state.data[j] & Listed)) {
+                            next.push_back(j);
+                        }
+                        state.data[j] = Listed;
+                    }
+                }
+            }
+            // Pixels both passes kept drop out until a neighbour goes
+            for (size_t k = 0; k < candidates.size(); ++k) {
+                size_t i = candidates[k];
+                if (removed[k]) {
+                    continue;
+                }
+                if ((state.data[i] & (KeptFirst | KeptSecond)) == (KeptFirst | KeptSecond)) {
+                    state.data[i] = 0;
+                } else {
+                    next.push_back(i);
+                }
+            }
+            candidates.swap(next);
+        }
+        return true;
+    }
+
+    // Chains of skeleton pixels between nodes: ends and junctions, where the
+    // ink around a pixel is not exactly two runs. Rings without nodes come last.
+    // False when it stopped at a limit; paths before `firstPath` do not count.
+    bool trace(RasterPaths& paths, size_t firstPath, const Limits& limits) {
+        const unsigned char* data = skeleton.data;
+        const size_t w = skeleton.cols;
+        visited.create(skeleton.size(), CV_8U);
+        visited.setTo(0);
+
+        pixels.clear();
+        for (size_t i = 0; i < skeleton.total(); ++i) {
+            if (data[i]) {
+                pixels.push_back(i);
+            }
+        }
+        auto isNode = [&](size_t i) { return crossings[neighbours(i)] != 2; };
+
+        // Straight neighbours first, so a staircase is walked step by step
+        // rather than cut across and left behind as a stub
+        const ptrdiff_t steps[8] = {
+            -static_cast<ptrdiff_t>(w), 1, static_cast<ptrdiff_t>(w), -1,
+            -static_cast<ptrdiff_t>(w) + 1, static_cast<ptrdiff_t>(w) + 1,
+            static_cast<ptrdiff_t>(w) - 1, -static_cast<ptrdiff_t>(w) - 1
+        };
+        auto advance = [&](size_t at) -> size_t {
+            size_t open = SIZE_MAX;
+            for (ptrdiff_t step : steps) {
+                size_t j = at + step;
+                if (!data[j]) {
+                    continue;
+                }
+                if (isNode(j)) {
+                    // Arriving at a node ends the chain, but not straight
+                    // back at the node it left
+                    if (j != chain.front() || chain.size() > 3) {
+                        return j;
+                    }
+                } else if (!visited.data[j] && open == SIZE_MAX) {
+                    open = j;
+                }
+            }
+            return open;
+        };
+        auto follow = [&](size_t start, size_t first) {
+            chain.assign(1, start);
+            for (size_t at = first; at != SIZE_MAX; at = advance(at)) {
+                chain.push_back(at);
+                if (isNode(at)) {
+                    break;  // Other chains may still end here
+                }
+                visited.data[at] = 1;
+            }
+        };
+
+        // The clock is read once per block of pixels, not per pixel
+        const size_t checkEvery = 4096;
+        for (size_t k = 0; k < pixels.size(); ++k) {
+            if (k % checkEvery == 0 && limits.reached(paths.pathCount() - firstPath)) {
+                return false;
+            }
+            const size_t i = pixels[k];
+            if (!isNode(i)) {
+                continue;
+            }
+            for (ptrdiff_t step : steps) {
+                size_t j = i + step;
+                if (data[j] && !visited.data[j] && !isNode(j)) {
+                    follow(i, j);
+                    emit(paths, false);
+                }
+            }
+        }
+        for (size_t k = 0; k < pixels.size(); ++k) {
+            if (k % checkEvery == 0 && limits.reached(paths.pathCount() - firstPath)) {
+                return false;
+            }
+            const size_t i = pixels[k];
+            if (!visited.data[i] && !isNode(i)) {
+                visited.data[i] = 1;
+                follow(i, advance(i));
+                emit(paths, true);
+            }
+        }
+        return true;
+    }
+
+    void emit(RasterPaths& paths, bool ring) {
+        const size_t w = skeleton.cols;
+        const float* dist = distance.ptr<float>();
+        double length = 0.0, radius = 0.0;
+        for (size_t k = 0; k < chain.size(); ++k) {
+            radius += dist[chain[k]];
+            if (k > 0) {
+                ptrdiff_t dx = static_cast<ptrdiff_t>(chain[k] % w) - static_cast<ptrdiff_t>(chain[k - 1] % w);
+                ptrdiff_t dy = static_cast<ptrdiff_t>(chain[k] / w) - static_cast<ptrdiff_t>(chain[k - 1] / w);
+                length += std::hypot(static_cast<double>(dx), static_cast<double>(dy));
+            }
+        }
+        // A pixel wide line is 1 px from the paper at its centre, so the
+        // width is twice the mean distance less the centre pixel's own half
+        double width = std::max(1.0, 2.0 * radius / chain.size() - 1.0);
+        // Chains shorter than the stroke is wide that touch a junction are
+        // corners and crossings of the stroke, not lines
+        bool atJunction = !ring &&
+            (crossings[neighbours(chain.front())] >= 3 || crossings[neighbours(chain.back())] >= 3);
+        if (length < options.minLength || (atJunction && length < width)) {
+            return;
+        }
+
+        bool closed = false;
+        if (ring) {
+            ptrdiff_t dx = static_cast<ptrdiff_t>(chain.back() % w) - static_cast<ptrdiff_t>(chain.front() % w);
+            ptrdiff_t dy = static_cast<ptrdiff_t>(chain.back() / w) - static_cast<ptrdiff_t>(chain.front() / w);
+            closed = chain.size() >= 3 && std::abs(dx) <= 1 && std::abs(dy) <= 1;
+        }
+        for (size_t i : chain) {
+            // Back to image coordinates, outside the paper border
+            paths.addPoint(static_cast<double>(i % w) - 1.0, static_cast<double>(i / w) - 1.0);
+        }
+        paths.endPath(closed, static_cast<float>(width));
+    }
+
+    Options options;
+    unsigned char crossings[256];  // Ink runs around a pixel: 1 at an end, 2 along a line
+    bool removableFirst[256];
+    bool removableSecond[256];
+
+    // Kept across pages so their buffers are reused
+    cv::Mat ink, skeleton, distance, state, visited;
+    std::vector<size_t> candidates, next, pixels, chain;
+    std::vector<char> removed;
+};
+
+} // namespace
+
+void RasterPaths::simplify(double tolerance, size_t firstPath) {
+    if (tolerance <= 0.0 || firstPath >= pathCount()) {
+        return;
+    }
+    const double tolerance2 = tolerance * tolerance;
+    std::vector<char> keep;
+    std::vector<std::pair<size_t, size_t>> spans;
+
+    // Kept points move down in place; a path never writes past its own start
+    size_t out = starts[firstPath];
+    for (size_t p = firstPath; p < pathCount(); ++p) {
+        const size_t first = starts[p];
+        const size_t count = starts[p + 1] - first;
+        const double* xy = coords.data() + 2 * first;
+        keep.assign(count, 1);
+
+        if (count > 2) {
+            std::fill(keep.begin() + 1, keep.end() - 1, 0);
+            spans.assign(1, {0, count - 1});
+            while (!spans.empty()) {
+                auto [a, b] = spans.back();
+                spans.pop_back();
+                double dx = xy[2 * b] - xy[2 * a];
+                double dy = xy[2 * b + 1] - xy[2 * a + 1];
+                double length2 = dx * dx + dy * dy;
+
+                double worst = 0.0;
+                size_t worstAt = a;
+                for (size_t i = a + 1; i < b; ++i) {
+                    double ex = xy[2 * i] - xy[2 * a];
+                    double ey = xy[2 * i + 1] - xy[2 * a + 1];
+                    // Distance to the chord, or to its start when a closed path's ends meet
+                    double cross = ex * dy - ey * dx;
+                    double d2 = length2 > 0.0 ? cross * cross / length2 : ex * ex + ey * ey;
+                    if (d2 > worst) {
+                        worst = d2;
+                        worstAt = i;
+                    }
+                }
+                if (worst > tolerance2) {
+                    keep[worstAt] = 1;
+                    spans.push_back({a, worstAt});
+                    spans.push_back({worstAt, b});
+                }
+            }
+        }
+
+        starts[p] = out;
+        for (size_t i = 0; i < count; ++i) {
+            if (keep[i]) {
+                coords[2 * out] = xy[2 * i];
+                coords[2 * out + 1] = xy[2 * i + 1];
+                ++out;
+            }
+        }
+        if (out - starts[p] < 3) {
+            closed[p] = 0;  // Closing a two-point path would only retrace it
+        }
+    }
+    starts[pathCount()] = out;
+    coords.resize(2 * out);
+}
+
+std::unique_ptr<RasterVectorizer> RasterVectorizer::create(Backend backend, const Options& options) {
+    switch (backend) {
+        case Backend::Segments:
+            return std::make_unique<SegmentVectorizer>(options);
+        case Backend::Centerline:
+            return std::make_unique<CenterlineVectorizer>(options);
+        default:
+            return std::make_unique<ContourVectorizer>();
+    }
+}
+
+const char* RasterVectorizer::backendName(Backend backend) {
+    switch (backend) {
+        case Backend::Segments: return "segments";
+        case Backend::Centerline: return "centerline";
+        default: return "contours";
+    }
+}
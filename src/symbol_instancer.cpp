@@ -0,0 +1,296 @@
+#include "symbol_instancer.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+struct UnionFind {
+    std::vector<uint32_t> parent;
+
+    explicit UnionFind(size_t size) : parent(size) {
+        for (size_t i = 0; i < size; ++i) {
+            parent[i] = static_cast<uint32_t>(i);
+        }
+    }
+
+    uint32_t find(uint32_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a != b) {
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+};
+
+uint64_t cellKey(int64_t cx, int64_t cy) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) |
+        static_cast<uint32_t>(cy);
+}
+
+// Placement of a cluster relative to its canonical form
+struct Pose {
+    double cx = 0.0, cy = 0.0;
+    double angle = 0.0;  // Radians
+    double scale = 1.0;
+};
+
+struct Shape {
+    std::vector<int64_t> key;  // Sorted, quantized canonical segments
+    uint64_t hash = 0;
+    Pose pose;
+};
+
+// A set of clusters that share one canonical shape
+struct Group {
+    std::vector<int64_t> key;
+    std::vector<size_t> clusters;
+    std::vector<Pose> poses;
+};
+
+} // namespace
+
+SymbolInstancer::SymbolInstancer() = default;
+
+SymbolInstancer::SymbolInstancer(const Options& options) : options(options) {}
+
+SymbolInstancer::Result SymbolInstancer::detect(const std::vector<PDFProcessor::VectorElement>& vectors) const {
+    Result result;
+    result.instanced.assign(vectors.size(), false);
+
+    std::vector<uint32_t> lines;
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        if (vectors[i].type == PDFProcessor::VectorElement::Type::LINE) {
+            lines.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    if (lines.size() < options.minSegments * options.minInstances) {
+        return result;
+    }
+
+    // Connect segments whose endpoints meet, using a grid of tolerance-sized cells
+    const double tolerance = std::max(options.joinTolerance, 1e-9);
+    const double tolerance2 = tolerance * tolerance;
+    UnionFind clusters(lines.size());
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells;  // cell -> endpoint ids
+    cells.reserve(lines.size() * 2);
+    auto endpoint = [&](uint32_t id) {
+        const auto& p = vectors[lines[id / 2]].points;
+        return std::make_pair(p[2 * (id % 2)], p[2 * (id % 2) + 1]);
+    };
+    for (uint32_t id = 0; id < lines.size() * 2; ++id) {
+        auto pt = endpoint(id);
+        int64_t cx = static_cast<int64_t>(std::floor(pt.first / tolerance));
+        int64_t cy = static_cast<int64_t>(std::floor(pt.second / tolerance));
+        for (int64_t dx = -1; dx <= 1; ++dx) {
+            for (int64_t dy = -1; dy <= 1; ++dy) {
+                auto found = cells.find(cellKey(cx + dx, cy + dy));
+                if (found == cells.end()) {
+                    continue;
+                }
+                for (uint32_t other : found->second) {
+                    auto q = endpoint(other);
+                    double ex = q.first - pt.first, ey = q.second - pt.second;
+                    if (ex * ex + ey * ey <= tolerance2) {
+                        clusters.unite(id / 2, other / 2);
+                    }
+                }
+            }
+        }
+        cells[cellKey(cx, cy)].push_back(id);
+    }
+    cells.clear();
+
+    std::unordered_map<uint32_t, std::vector<uint32_t>> members;  // root -> line ids
+    for (uint32_t i = 0; i < lines.size(); ++i) {
+        members[clusters.find(i)].push_back(i);
+    }
+
+    // Canonicalize every candidate cluster and bucket by shape
+    std::vector<std::vector<uint32_t>> clusterLines;
+    std::vector<Group> groups;
+    std::unordered_map<uint64_t, std::vector<size_t>> groupsByHash;
+
+    for (auto& entry : members) {
+        std::vector<uint32_t>& segs = entry.second;
+        if (segs.size() < options.minSegments || segs.size() > options.maxSegments) {
+            continue;
+        }
+        std::sort(segs.begin(), segs.end());
+
+        // Length-weighted centroid and second moments of the segments
+        double total = 0.0, sx = 0.0, sy = 0.0;
+        for (uint32_t s : segs) {
+            const auto& p = vectors[lines[s]].points;
+            double length = std::hypot(p[2] - p[0], p[3] - p[1]);
+            total += length;
+            sx += length * (p[0] + p[2]) * 0.5;
+            sy += length * (p[1] + p[3]) * 0.5;
+        }
+        if (total <= 0.0) {
+            continue;
+        }
+
+        Shape shape;
+        shape.pose.cx = sx / total;
+        shape.pose.cy = sy / total;
+        double cxx = 0.0, cxy = 0.0, cyy = 0.0;
+        for (uint32_t s : segs) {
+            const auto& p = vectors[lines[s]].points;
+            double length = std::hypot(p[2] - p[0], p[3] - p[1]);
+            double ax = p[0] - shape.pose.cx, ay = p[1] - shape.pose.cy;
+            double bx = p[2] - shape.pose.cx, by = p[3] - shape.pose.cy;
+            cxx += length * (ax * ax + ax * bx + bx * bx) / 3.0;
+            cyy += length * (ay * ay + ay * by + by * by) / 3.0;
+            cxy += length * (2.0 * ax * ay + ax * by + bx * ay + 2.0 * bx * by) / 6.0;
+        }
+        double rms = std::sqrt((cxx + cyy) / total);
+        if (rms <= tolerance) {
+            continue;
+        }
+
+        // Orientation: principal axis when the shape has one, otherwise the
+        // direction of the farthest endpoint
+        double anisotropy = std::hypot(cxx - cyy, 2.0 * cxy) / (cxx + cyy);
+        if (anisotropy > 0.05) {
+            shape.pose.angle = 0.5 * std::atan2(2.0 * cxy, cxx - cyy);
+            // Pick the axis direction the shape leans towards
+            double c = std::cos(shape.pose.angle), sn = std::sin(shape.pose.angle);
+            double skew = 0.0;
+            for (uint32_t s : segs) {
+                const auto& p = vectors[lines[s]].points;
+                double length = std::hypot(p[2] - p[0], p[3] - p[1]);
+                for (int e = 0; e < 2; ++e) {
+                    double u = (p[2 * e] - shape.pose.cx) * c + (p[2 * e + 1] - shape.pose.cy) * sn;
+                    skew += 0.5 * length * u * u * u;
+                }
+            }
+            if (skew < -1e-3 * total * rms * rms * rms) {
+                shape.pose.angle += kPi;
+            }
+        } else {
+            double farthest = -1.0;
+            for (uint32_t s : segs) {
+                const auto& p = vectors[lines[s]].points;
+                for (int e = 0; e < 2; ++e) {
+                    double dx = p[2 * e] - shape.pose.cx, dy = p[2 * e + 1] - shape.pose.cy;
+                    double d = dx * dx + dy * dy;
+                    if (d > farthest * (1.0 + 1e-9)) {
+                        farthest = d;
+                        shape.pose.angle = std::atan2(dy, dx);
+                    }
+                }
+            }
+        }
+        shape.pose.scale = rms;
+
+        // Quantized canonical segments, endpoints and segments in a fixed order.
+        // Widths are not scaled: a copy drawn larger keeps its pen.
+        double c = std::cos(-shape.pose.angle), sn = std::sin(-shape.pose.angle);
+        double inv = 1.0 / (rms * options.shapeQuantum);
+        double widthInv = 1.0 / std::max(options.widthQuantum, 1e-9);
+        std::vector<std::array<int64_t, 5>> canonical;
+        canonical.reserve(segs.size());
+        for (uint32_t s : segs) {
+            const auto& p = vectors[lines[s]].points;
+            int64_t q[4];
+            for (int e = 0; e < 2; ++e) {
+                double dx = p[2 * e] - shape.pose.cx, dy = p[2 * e + 1] - shape.pose.cy;
+                q[2 * e] = std::llround((dx * c - dy * sn) * inv);
+                q[2 * e + 1] = std::llround((dx * sn + dy * c) * inv);
+            }
+            if (std::make_pair(q[2], q[3]) < std::make_pair(q[0], q[1])) {
+                std::swap(q[0], q[2]);
+                std::swap(q[1], q[3]);
+            }
+            int64_t width = std::llround(vectors[lines[s]].thickness * widthInv);
+            canonical.push_back({q[0], q[1], q[2], q[3], width});
+        }
+        std::sort(canonical.begin(), canonical.end());
+
+        if (!options.allowScaling) {
+            shape.key.push_back(std::llround(rms / tolerance));
+        }
+        for (const auto& seg : canonical) {
+            shape.key.insert(shape.key.end(), seg.begin(), seg.end());
+        }
+        shape.hash = 14695981039346656037ULL;
+        for (int64_t v : shape.key) {
+            shape.hash = (shape.hash ^ static_cast<uint64_t>(v)) * 1099511628211ULL;
+        }
+
+        // Same hash is only a candidate; the full key must match
+        size_t clusterIndex = clusterLines.size();
+        clusterLines.push_back(std::move(segs));
+        auto& candidates = groupsByHash[shape.hash];
+        Group* group = nullptr;
+        for (size_t g : candidates) {
+            if (groups[g].key == shape.key) {
+                group = &groups[g];
+                break;
+            }
+        }
+        if (!group) {
+            candidates.push_back(groups.size());
+            groups.push_back(Group());
+            group = &groups.back();
+            group->key = std::move(shape.key);
+        }
+        group->clusters.push_back(clusterIndex);
+        group->poses.push_back(shape.pose);
+    }
+
+    // Shapes that repeat become blocks defined by their first occurrence.
+    // Occurrence i is then block * (scale_i / scale_0), rotated by angle_i.
+    for (const auto& group : groups) {
+        if (group.clusters.size() < options.minInstances) {
+            continue;
+        }
+
+        Block block;
+        block.name = "SYM_" + std::to_string(result.blocks.size() + 1);
+        block.instances = group.clusters.size();
+        const Pose& reference = group.poses.front();
+        double c = std::cos(-reference.angle), sn = std::sin(-reference.angle);
+        for (uint32_t s : clusterLines[group.clusters.front()]) {
+            const auto& p = vectors[lines[s]].points;
+            for (int e = 0; e < 2; ++e) {
+                double dx = p[2 * e] - reference.cx, dy = p[2 * e + 1] - reference.cy;
+                block.segments.push_back(dx * c - dy * sn);
+                block.segments.push_back(dx * sn + dy * c);
+            }
+            block.widths.push_back(vectors[lines[s]].thickness);
+        }
+
+        for (size_t m = 0; m < group.clusters.size(); ++m) {
+            const Pose& pose = group.poses[m];
+            Insert insert;
+            insert.block = result.blocks.size();
+            insert.x = pose.cx;
+            insert.y = pose.cy;
+            insert.scale = options.allowScaling ? pose.scale / reference.scale : 1.0;
+            insert.rotation = std::fmod(pose.angle * 180.0 / kPi + 360.0, 360.0);
+            result.inserts.push_back(insert);
+
+            for (uint32_t s : clusterLines[group.clusters[m]]) {
+                result.instanced[lines[s]] = true;
+                result.instancedSegments++;
+            }
+        }
+        result.blocks.push_back(std::move(block));
+    }
+
+    return result;
+}
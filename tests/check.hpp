@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the behaviour tests. A failed CHECK reports itself and
+// the test keeps going; main() returns testResult() so ctest sees the failure.
+namespace test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int testResult() {
+    if (failures() > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures());
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace test
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                         #condition);                                             \
+            ++test::failures();                                                   \
+        }                                                                         \
+    } while (0)
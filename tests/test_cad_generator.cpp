@@ -0,0 +1,219 @@
+#include "check.hpp"
+#include "cad_generator.hpp"
+#include "output_sink.hpp"
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Every object in a DXF has a unique upper-case hex handle, image links point
+// at handles that exist, and $HANDSEED is above all of them, however many
+// writer threads formatted the entities.
+
+namespace {
+
+using Vector = PDFProcessor::VectorElement;
+using Group = std::pair<int, std::string>;
+
+std::vector<Group> parseGroups(const std::string& dxf) {
+    std::vector<Group> groups;
+    std::istringstream in(dxf);
+    std::string code, value;
+    while (std::getline(in, code) && std::getline(in, value)) {
+        groups.emplace_back(std::stoi(code), value);
+    }
+    return groups;
+}
+
+bool isHexHandle(const std::string& value) {
+    if (value.empty() || value.size() > 16) return false;
+    for (char c : value) {
+        if (!std::isdigit(static_cast<unsigned char>(c)) && !(c >= 'A' && c <= 'F')) return false;
+    }
+    return true;
+}
+
+// Checks the handles of one drawing and returns how many objects it has
+size_t checkHandles(const std::string& dxf) {
+    const std::vector<Group> groups = parseGroups(dxf);
+    CHECK(!groups.empty());
+    CHECK(groups.back() == Group(0, "EOF"));
+
+    unsigned long long seed = 0;
+    std::set<unsigned long long> handles;
+    std::vector<std::string> owners, links;
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const auto& [code, value] = groups[i];
+        if (code == 9 && value == "$HANDSEED" && i + 1 < groups.size()) {
+            CHECK(groups[i + 1].first == 5);
+            CHECK(isHexHandle(groups[i + 1].second));
+            seed = std::stoull(groups[i + 1].second, nullptr, 16);
+            ++i;
+        } else if (code == 5 || code == 105) {
+            CHECK(isHexHandle(value));
+            CHECK(handles.insert(std::stoull(value, nullptr, 16)).second);
+        } else if (code == 330) {
+            owners.push_back(value);
+        } else if (code == 340 || code == 350 || code == 360) {
+            links.push_back(value);
+        }
+    }
+
+    CHECK(!handles.empty());
+    CHECK(seed > *handles.rbegin());
+    for (const std::string& owner : owners) {
+        CHECK(isHexHandle(owner));
+    }
+    // IMAGE, IMAGEDEF and reactor objects refer to each other by handle
+    for (const std::string& link : links) {
+        CHECK(isHexHandle(link));
+        CHECK(handles.count(std::stoull(link, nullptr, 16)) == 1);
+    }
+    return handles.size();
+}
+
+std::vector<Vector> makeVectors() {
+    std::vector<Vector> vectors;
+    // A repeated square, so instancing has something to turn into a block,
+    // and a run of distinct lines
+    for (int copy = 0; copy < 20; ++copy) {
+        const double x = copy * 12.0;
+        const double square[4][4] = {
+            {x, 0, x + 5, 0}, {x + 5, 0, x + 5, 5}, {x + 5, 5, x, 5}, {x, 5, x, 0}};
+        for (const auto& p : square) {
+            vectors.push_back({Vector::Type::LINE, {p[0], p[1], p[2], p[3]}, 0.25, 0});
+        }
+    }
+    for (int i = 0; i < 300; ++i) {
+        vectors.push_back({Vector::Type::LINE, {i * 0.5, 20.0, i * 0.5 + 0.3, 20.0 + i * 0.1}, 0.0, 1});
+    }
+    return vectors;
+}
+
+std::vector<PDFProcessor::ImageElement> makeImages() {
+    std::vector<PDFProcessor::ImageElement> images;
+    for (int i = 0; i < 3; ++i) {
+        PDFProcessor::ImageElement image;
+        image.path = i == 2 ? "images/a.png" : "images/b.png";  // Two placements share a file
+        image.pixelWidth = 40;
+        image.pixelHeight = 30;
+        image.x = 10.0 * i;
+        image.y = 50.0;
+        image.uX = 0.1;
+        image.uY = 0.0;
+        image.vX = 0.0;
+        image.vY = 0.1;
+        images.push_back(image);
+    }
+    return images;
+}
+
+std::string generate(const CADGenerator::Options& options) {
+    CADGenerator generator;
+    generator.setOptions(options);
+    generator.setImageElements(makeImages());
+    std::string dxf;
+    auto sink = OutputSink::toBuffer(dxf, {});
+    CHECK(generator.generateCAD(makeVectors(), {"Title", "Notes"}, *sink));
+    return dxf;
+}
+
+void testHandlesAreUniqueAndBelowSeed() {
+    CADGenerator::Options options;
+    options.writerThreads = 1;
+    const std::string single = generate(options);
+    const size_t objects = checkHandles(single);
+    CHECK(objects > makeVectors().size());
+
+    // Several threads and small chunks give the same drawing
+    options.writerThreads = 4;
+    options.entitiesPerChunk = 7;
+    CHECK(generate(options) == single);
+}
+
+void testInstancedHandles() {
+    CADGenerator::Options options;
+    options.instanceSymbols = true;
+    options.entitiesPerChunk = 5;
+    const std::string dxf = generate(options);
+    CHECK(dxf.find("INSERT") != std::string::npos);
+    checkHandles(dxf);
+}
+
+void testStreamedHandles() {
+    const auto path = std::filesystem::temp_directory_path() / "pdf2cad_test_stream.dxf";
+    CADGenerator generator;
+    CADGenerator::Options options;
+    options.entitiesPerChunk = 11;
+    generator.setOptions(options);
+    CHECK(generator.beginStream(path.string()));
+    const std::vector<Vector> vectors = makeVectors();
+    const size_t half = vectors.size() / 2;
+    CHECK(generator.streamVectors({vectors.begin(), vectors.begin() + half}));
+    CHECK(generator.streamVectors({vectors.begin() + half, vectors.end()}));
+    generator.setImageElements(makeImages());
+    CHECK(generator.finishStream());
+
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    in.close();
+    checkHandles(contents.str());
+    std::filesystem::remove(path);
+}
+
+// Refuses everything from the `failAt`th write on and counts the writes it
+// was still asked to do after that
+class FailingSink : public OutputSink {
+public:
+    explicit FailingSink(size_t failAt) : failAt(failAt) {}
+
+    bool write(const char*, size_t size) override {
+        stats.bytesIn += size;
+        if (writes++ >= failAt) {
+            writesAfterFailure += failed ? 1 : 0;
+            failed = true;
+        }
+        return !failed;
+    }
+    bool finish() override { return !failed; }
+    const Stats& getStats() const override { return stats; }
+
+    size_t writes = 0;
+    size_t writesAfterFailure = 0;
+
+private:
+    size_t failAt;
+    bool failed = false;
+    Stats stats;
+};
+
+void testStopsAtFirstFailedWrite() {
+    // Count the writes of a good run, then fail at each of them in turn
+    FailingSink counting(~size_t(0));
+    CADGenerator generator;
+    CHECK(generator.generateCAD(makeVectors(), {"Title"}, counting));
+    CHECK(counting.writes > 3);
+
+    for (size_t failAt = 0; failAt < counting.writes; ++failAt) {
+        FailingSink sink(failAt);
+        CADGenerator failing;
+        CHECK(!failing.generateCAD(makeVectors(), {"Title"}, sink));
+        CHECK(sink.writesAfterFailure == 0);
+    }
+}
+
+} // namespace
+
+int main() {
+    testHandlesAreUniqueAndBelowSeed();
+    testInstancedHandles();
+    testStreamedHandles();
+    testStopsAtFirstFailedWrite();
+    return test::testResult();
+}
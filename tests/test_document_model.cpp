@@ -0,0 +1,148 @@
+#include "check.hpp"
+#include "cad_generator.hpp"
+#include "document_model.hpp"
+#include "document_model.pb.h"
+#include <google/protobuf/util/delimited_message_util.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A version 2 model reads back as written, stroke widths included, and
+// reaches the DXF as lineweights; version 1 files still import, with their
+// placeholder thickness dropped so their lines stay ByLayer.
+
+namespace {
+
+using pdf2cad::model::DocumentHeader;
+using pdf2cad::model::Entity;
+using pdf2cad::model::Page;
+
+std::string tempPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// Page i has a measured 0.35 mm line and an unmeasured one
+Page makePage(unsigned index, double thickness) {
+    Page page;
+    page.set_index(index);
+    page.set_width(210.0);
+    page.set_height(297.0);
+    page.set_offset_x(220.0 * index);
+    for (double width : {thickness, 0.0}) {
+        Entity* entity = page.add_entities();
+        entity->set_type(Entity::LINE);
+        for (double value : {220.0 * index, 10.0, 220.0 * index + 50.0, 10.0 + width}) {
+            entity->add_points(value);
+        }
+        entity->set_thickness(width);
+    }
+    page.add_texts()->set_text("Page " + std::to_string(index + 1));
+    return page;
+}
+
+DocumentHeader makeHeader(unsigned pages) {
+    DocumentHeader header;
+    header.set_page_count(pages);
+    header.mutable_metadata()->set_source_path("drawing.pdf");
+    header.mutable_metadata()->set_render_scale(4.0);
+    return header;
+}
+
+// Writes the file the way an older pdf2cad did, with the version it asks for
+void writeWithVersion(const std::string& path, unsigned version, double thickness) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    DocumentHeader header = makeHeader(1);
+    header.set_format_version(version);
+    CHECK(google::protobuf::util::SerializeDelimitedToOstream(header, &file));
+    CHECK(google::protobuf::util::SerializeDelimitedToOstream(makePage(0, thickness), &file));
+}
+
+// The group 370 values of the drawing's LINE entities, in order
+std::vector<std::string> lineweights(const std::string& dxfPath) {
+    std::ifstream in(dxfPath, std::ios::binary);
+    std::vector<std::string> weights;
+    bool inLine = false;
+    for (std::string code, value; std::getline(in, code) && std::getline(in, value);) {
+        if (code == "0") {
+            inLine = value == "LINE";
+        } else if (inLine && code == "370") {
+            weights.push_back(value);
+        }
+    }
+    return weights;
+}
+
+void testVersion2RoundTrip() {
+    const std::string path = tempPath("pdf2cad_test_model_v2.pb");
+    {
+        DocumentModelWriter writer;
+        CHECK(writer.open(path, makeHeader(3)));
+        for (unsigned i = 0; i < 3; ++i) {
+            CHECK(writer.writePage(makePage(i, 0.35)));
+        }
+        CHECK(writer.close());
+    }
+
+    DocumentModelReader reader;
+    CHECK(reader.open(path));
+    CHECK(reader.getHeader().format_version() == 2);
+    CHECK(reader.getHeader().page_count() == 3);
+    CHECK(reader.getHeader().metadata().source_path() == "drawing.pdf");
+    Page page;
+    CHECK(reader.readPage(page));
+    CHECK(page.SerializeAsString() == makePage(0, 0.35).SerializeAsString());
+    CHECK(reader.skipPage());
+    CHECK(reader.readPage(page));
+    CHECK(page.index() == 2);
+    CHECK(page.entities_size() == 2 && page.entities(0).thickness() == 0.35);
+    CHECK(!reader.readPage(page));  // End of file
+    std::filesystem::remove(path);
+}
+
+void testImportKeepsVersion2Widths() {
+    const std::string model = tempPath("pdf2cad_test_import_v2.pb");
+    const std::string dxf = tempPath("pdf2cad_test_import_v2.dxf");
+    writeWithVersion(model, 2, 0.35);
+
+    CADGenerator generator;
+    CHECK(generator.importModel(model));
+    CHECK(generator.generateCAD(dxf, CADGenerator::Format::DXF));
+    CHECK(lineweights(dxf) == std::vector<std::string>({"35", "-1"}));
+    std::filesystem::remove(model);
+    std::filesystem::remove(dxf);
+}
+
+void testVersion1ThicknessIsNotAWidth() {
+    const std::string model = tempPath("pdf2cad_test_import_v1.pb");
+    const std::string dxf = tempPath("pdf2cad_test_import_v1.dxf");
+    // Version 1 stored a placeholder 1.0, which would be a 1 mm lineweight
+    writeWithVersion(model, 1, 1.0);
+
+    CADGenerator generator;
+    CHECK(generator.importModel(model));
+    CHECK(generator.generateCAD(dxf, CADGenerator::Format::DXF));
+    CHECK(lineweights(dxf) == std::vector<std::string>({"-1", "-1"}));
+    std::filesystem::remove(model);
+    std::filesystem::remove(dxf);
+}
+
+void testRejectsUnknownVersions() {
+    const std::string path = tempPath("pdf2cad_test_model_v3.pb");
+    for (unsigned version : {0u, 3u}) {
+        writeWithVersion(path, version, 0.35);
+        DocumentModelReader reader;
+        CHECK(!reader.open(path));
+    }
+    std::filesystem::remove(path);
+}
+
+} // namespace
+
+int main() {
+    testVersion2RoundTrip();
+    testImportKeepsVersion2Widths();
+    testVersion1ThicknessIsNotAWidth();
+    testRejectsUnknownVersions();
+    return test::testResult();
+}
@@ -0,0 +1,107 @@
+#include "check.hpp"
+#include "geometry_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// The batch kernels use SSE2 for pairs of points and plain code for the
+// tail; both must give exactly what the one-point-at-a-time formula gives.
+
+namespace {
+
+void referenceTransform(std::vector<double>& xy, const geometry::Transform& t, double grid,
+                        geometry::Extents& extents) {
+    for (size_t i = 0; i + 1 < xy.size(); i += 2) {
+        double x = xy[i] * t.sx + t.tx;
+        double y = xy[i + 1] * t.sy + t.ty;
+        if (grid > 0.0) {
+            x = std::nearbyint(x * (1.0 / grid)) * grid;
+            y = std::nearbyint(y * (1.0 / grid)) * grid;
+        }
+        xy[i] = x;
+        xy[i + 1] = y;
+        extents.minX = std::min(extents.minX, x);
+        extents.minY = std::min(extents.minY, y);
+        extents.maxX = std::max(extents.maxX, x);
+        extents.maxY = std::max(extents.maxY, y);
+    }
+}
+
+bool sameExtents(const geometry::Extents& a, const geometry::Extents& b) {
+    return a.minX == b.minX && a.minY == b.minY && a.maxX == b.maxX && a.maxY == b.maxY;
+}
+
+void testTransformMatchesScalar() {
+    std::mt19937 random(26);
+    std::uniform_real_distribution<double> pixel(-50.0, 5000.0);
+    const geometry::Transform transform = geometry::makePageTransform(842.0, 4.0, 210.0, 3.5);
+
+    // Every tail length, with and without snapping
+    for (double grid : {0.0, 0.01, 0.5}) {
+        for (size_t count = 0; count <= 9; ++count) {
+            std::vector<double> points(2 * count);
+            for (double& v : points) {
+                v = pixel(random);
+            }
+            std::vector<double> expected = points;
+            geometry::Extents expectedExtents;
+            referenceTransform(expected, transform, grid, expectedExtents);
+
+            geometry::Extents extents;
+            geometry::transformPoints(points.data(), count, transform, grid, &extents);
+            CHECK(points == expected);
+            CHECK(sameExtents(extents, expectedExtents));
+
+            // Extents alone, and no extents at all
+            geometry::Extents accumulated;
+            geometry::accumulateExtents(expected.data(), count, accumulated);
+            CHECK(sameExtents(accumulated, expectedExtents));
+            CHECK(accumulated.isValid() == (count > 0));
+        }
+    }
+}
+
+void testSnapRoundsHalfToEven() {
+    // 0.5 and 2.5 grid units sit exactly between two grid points
+    double xy[] = {0.5, 2.5, 1.5, -0.5, 3.25, 7.0};
+    geometry::Transform identity;
+    geometry::transformPoints(xy, 3, identity, 1.0, nullptr);
+    CHECK(xy[0] == 0.0);
+    CHECK(xy[1] == 2.0);
+    CHECK(xy[2] == 2.0);
+    CHECK(xy[3] == -0.0);
+    CHECK(xy[4] == 3.0);
+    CHECK(xy[5] == 7.0);
+}
+
+void testPageTransform() {
+    // A pixel at the top-left corner of an A4 page at 4x lands at the top of the page
+    geometry::Transform t = geometry::makePageTransform(842.0, 4.0, 100.0, 0.0);
+    double xy[] = {0.0, 0.0, 4.0 * 595.0, 4.0 * 842.0};
+    geometry::Extents extents;
+    geometry::transformPoints(xy, 2, t, 0.0, &extents);
+    CHECK(std::abs(xy[0] - 100.0) < 1e-9);
+    CHECK(std::abs(xy[1] - 842.0 * geometry::kPointsToMillimeters) < 1e-9);
+    CHECK(std::abs(xy[2] - (100.0 + 595.0 * geometry::kPointsToMillimeters)) < 1e-9);
+    CHECK(std::abs(xy[3]) < 1e-9);
+    CHECK(extents.isValid());
+
+    geometry::Extents other;
+    other.minX = -1.0;
+    other.minY = 0.0;
+    other.maxX = 0.0;
+    other.maxY = 1000.0;
+    extents.merge(other);
+    CHECK(extents.minX == -1.0);
+    CHECK(extents.maxY == 1000.0);
+}
+
+} // namespace
+
+int main() {
+    testTransformMatchesScalar();
+    testSnapRoundsHalfToEven();
+    testPageTransform();
+    return test::testResult();
+}
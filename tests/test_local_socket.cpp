@@ -0,0 +1,136 @@
+#include "check.hpp"
+#include "local_socket.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+// Framing as the server and client use it: header lines, then raw bytes,
+// over a real socket. Also what listen() may and may not delete.
+
+namespace {
+
+std::string tempPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / (std::string("pdf2cad-test-") + name + "-" +
+        std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 1000000))).string();
+}
+
+void testLinesThenBytes() {
+    std::string path = tempPath("frames");
+    LocalSocket listener;
+    CHECK(listener.listen(path));
+
+    // The payload follows the lines in the same send, so readLine() has
+    // already buffered part of it when recvAll() takes over
+    std::string payload(100000, '\0');
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>(i * 7);
+    }
+    std::thread client([&] {
+        LocalSocket socket;
+        CHECK(socket.connect(path));
+        CHECK(socket.sendAll("input-size 100000\r\nrender-scale 2\n\n" + payload));
+        std::string reply;
+        CHECK(socket.readLine(reply));
+        CHECK(reply == "ok");
+    });
+
+    LocalSocket server = listener.accept();
+    CHECK(server.isValid());
+    std::string line;
+    CHECK(server.readLine(line) && line == "input-size 100000\r");
+    CHECK(server.readLine(line) && line == "render-scale 2");
+    CHECK(server.readLine(line) && line.empty());
+    std::string received(payload.size(), 'x');
+    CHECK(server.recvAll(&received[0], received.size()));
+    CHECK(received == payload);
+    CHECK(server.sendAll("ok\n"));
+    client.join();
+
+    // End of stream after the client is gone
+    CHECK(!server.readLine(line));
+}
+
+void testLongLineIsRefused() {
+    std::string path = tempPath("long");
+    LocalSocket listener;
+    CHECK(listener.listen(path));
+    std::thread client([&] {
+        LocalSocket socket;
+        CHECK(socket.connect(path));
+        // Never a newline; the server must give up rather than keep buffering
+        socket.sendAll(std::string(LocalSocket::kMaxLineBytes + 4096, 'a'));
+        std::string reply;
+        socket.readLine(reply);
+    });
+    LocalSocket server = listener.accept();
+    std::string line;
+    CHECK(!server.readLine(line));
+    server.close();
+    client.join();
+}
+
+void testListenLeavesOtherFilesAlone() {
+    // A regular file at the socket path is not deleted
+    std::string path = tempPath("file");
+    std::ofstream(path) << "keep me";
+    {
+        LocalSocket listener;
+        CHECK(!listener.listen(path));
+    }
+    CHECK(std::filesystem::is_regular_file(path));
+    std::filesystem::remove(path);
+
+    // A second server does not take over a live server's socket
+    path = tempPath("live");
+    LocalSocket first;
+    CHECK(first.listen(path));
+    {
+        LocalSocket second;
+        CHECK(!second.listen(path));
+    }
+    std::thread client([&] {
+        LocalSocket socket;
+        CHECK(socket.connect(path));
+    });
+    CHECK(first.accept().isValid());
+    client.join();
+}
+
+void testStaleSocketIsReplaced() {
+#ifndef _WIN32
+    // A socket file nobody listens on any more, as a crashed server leaves it
+    std::string path = tempPath("stale");
+    int s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    CHECK(::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    ::close(s);
+    CHECK(std::filesystem::exists(path));
+
+    LocalSocket listener;
+    CHECK(listener.listen(path));
+    listener.close();
+    CHECK(!std::filesystem::exists(path));
+#endif
+}
+
+} // namespace
+
+int main() {
+    testLinesThenBytes();
+    testLongLineIsRefused();
+    testListenLeavesOtherFilesAlone();
+    testStaleSocketIsReplaced();
+    return test::testResult();
+}
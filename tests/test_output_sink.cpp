@@ -0,0 +1,208 @@
+#include "check.hpp"
+#include "output_sink.hpp"
+#include <zlib.h>
+#include <zstd.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+// Whatever goes into a sink comes back byte for byte after decoding, for
+// every codec, with and without the compression thread, and through files,
+// buffers and forwarding sinks alike.
+
+namespace {
+
+using Compression = OutputSink::Compression;
+
+// DXF-like text with enough repetition to compress and enough noise not to
+// collapse to nothing
+std::string makeInput(size_t size) {
+    std::mt19937 random(32);
+    std::string input;
+    while (input.size() < size) {
+        input += "0\nLINE\n8\n0\n10\n" + std::to_string(random() % 100000 / 100.0) + "\n";
+    }
+    input.resize(size);
+    return input;
+}
+
+// Writes in uneven pieces, some larger than the handoff buffers
+bool writeInPieces(OutputSink& sink, const std::string& input) {
+    std::mt19937 random(7);
+    for (size_t at = 0; at < input.size();) {
+        size_t piece = std::min<size_t>(input.size() - at, random() % 3 == 0 ? 20000 : random() % 700);
+        if (!sink.write(input.data() + at, piece)) {
+            return false;
+        }
+        at += piece;
+    }
+    return sink.finish();
+}
+
+std::string gunzip(const std::string& data) {
+    z_stream stream{};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        return "";
+    }
+    std::string out;
+    char buffer[16384];
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    int result = Z_OK;
+    while (result == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    const bool complete = result == Z_STREAM_END && stream.avail_in == 0;
+    inflateEnd(&stream);
+    return complete ? out : "<truncated gzip>";
+}
+
+std::string unzstd(const std::string& data) {
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    std::string out;
+    char buffer[16384];
+    ZSTD_inBuffer in{data.data(), data.size(), 0};
+    bool complete = false;
+    for (;;) {
+        const size_t consumed = in.pos;
+        ZSTD_outBuffer outBuffer{buffer, sizeof(buffer), 0};
+        size_t result = ZSTD_decompressStream(stream, &outBuffer, &in);
+        out.append(buffer, outBuffer.pos);
+        // 0 means a frame ended and everything in it was flushed
+        complete = result == 0 && in.pos == in.size;
+        if (complete || ZSTD_isError(result) || (in.pos == consumed && outBuffer.pos == 0)) {
+            break;
+        }
+    }
+    ZSTD_freeDStream(stream);
+    return complete ? out : "<truncated zstd>";
+}
+
+std::string decode(const std::string& data, Compression compression) {
+    switch (compression) {
+        case Compression::Gzip: return gunzip(data);
+        case Compression::Zstd: return unzstd(data);
+        default: return data;
+    }
+}
+
+void testBufferRoundTrip() {
+    const std::string input = makeInput(3 << 20);
+    for (Compression compression : {Compression::None, Compression::Gzip, Compression::Zstd}) {
+        for (bool thread : {false, true}) {
+            OutputSink::Options options;
+            options.compression = compression;
+            options.compressionThread = thread;
+            options.bufferBytes = 64 * 1024;
+            std::string stored;
+            auto sink = OutputSink::toBuffer(stored, options);
+            CHECK(sink != nullptr);
+            if (!sink) continue;
+            CHECK(writeInPieces(*sink, input));
+            CHECK(decode(stored, compression) == input);
+            CHECK(sink->getStats().bytesIn == input.size());
+            CHECK(sink->getStats().bytesOut == stored.size());
+            if (compression != Compression::None) {
+                CHECK(stored.size() < input.size() / 2);
+            }
+        }
+    }
+}
+
+void testFileRoundTrip() {
+    const std::string input = makeInput(500000);
+    const auto directory = std::filesystem::temp_directory_path();
+    for (const char* name : {"pdf2cad_test_sink.dxf", "pdf2cad_test_sink.dxf.gz", "pdf2cad_test_sink.dxf.zst"}) {
+        const std::string path = (directory / name).string();
+        const Compression compression = OutputSink::compressionForPath(path);
+        auto sink = OutputSink::open(path, {});
+        CHECK(sink != nullptr);
+        if (!sink) continue;
+        CHECK(writeInPieces(*sink, input));
+        sink.reset();
+
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream stored;
+        stored << in.rdbuf();
+        in.close();
+        // Binary mode: LF stays LF on every platform
+        CHECK(decode(stored.str(), compression) == input);
+        std::filesystem::remove(path);
+    }
+    CHECK(OutputSink::open((directory / "no such directory" / "x.dxf").string(), {}) == nullptr);
+}
+
+void testEncodeToForwards() {
+    const std::string input = makeInput(200000);
+    std::string stored;
+    auto destination = OutputSink::toBuffer(stored, {});
+    OutputSink::Options options;
+    options.compression = Compression::Zstd;
+    options.compressionThread = true;
+    auto sink = OutputSink::encodeTo(*destination, options);
+    CHECK(writeInPieces(*sink, input));
+    CHECK(unzstd(stored) == input);
+    CHECK(destination->getStats().bytesIn == stored.size());
+}
+
+// Fails every write after the first `budget` bytes
+class FailingSink : public OutputSink {
+public:
+    explicit FailingSink(size_t budget) : budget(budget) {}
+
+    bool write(const char*, size_t size) override {
+        stats.bytesIn += size;
+        if (size > budget) {
+            budget = 0;
+            failed = true;
+        } else {
+            budget -= size;
+        }
+        return !failed;
+    }
+    bool finish() override { return !failed; }
+    const Stats& getStats() const override { return stats; }
+
+private:
+    size_t budget;
+    bool failed = false;
+    Stats stats;
+};
+
+void testFailuresReachTheWriter() {
+    for (Compression compression : {Compression::None, Compression::Gzip, Compression::Zstd}) {
+        for (bool thread : {false, true}) {
+            FailingSink destination(1000);
+            OutputSink::Options options;
+            options.compression = compression;
+            options.compressionThread = thread;
+            options.bufferBytes = 4096;
+            auto sink = OutputSink::encodeTo(destination, options);
+            // Random bytes do not compress, so the budget runs out early
+            std::mt19937 random(1);
+            std::string noise(1 << 20, '\0');
+            for (char& c : noise) c = static_cast<char>(random());
+            bool ok = true;
+            for (size_t at = 0; ok && at < noise.size(); at += 8192) {
+                ok = sink->write(noise.data() + at, 8192);
+            }
+            CHECK(!(ok && sink->finish()));
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    testBufferRoundTrip();
+    testFileRoundTrip();
+    testEncodeToForwards();
+    testFailuresReachTheWriter();
+    return test::testResult();
+}
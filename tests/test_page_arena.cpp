@@ -0,0 +1,52 @@
+#include "check.hpp"
+#include "page_arena.hpp"
+#include <vector>
+
+// The retained block grows to fit a large page and shrinks back once a run
+// of ordinary pages no longer needs it.
+
+namespace {
+
+void allocatePage(PageArena& arena, size_t bytes) {
+    std::pmr::vector<char> page(arena.resource());
+    page.resize(bytes);
+    page.clear();
+    page.shrink_to_fit();
+    arena.release();
+}
+
+void testGrowsAndShrinks() {
+    const size_t initial = 64 * 1024;
+    PageArena arena(initial);
+    CHECK(arena.getStats().retainedBytes == initial);
+
+    // A page too big for the block overflows to the heap once, then fits
+    allocatePage(arena, 1 << 20);
+    const size_t grown = arena.getStats().retainedBytes;
+    CHECK(grown >= (1 << 20));
+    CHECK(arena.getStats().upstreamAllocations == 1);
+    allocatePage(arena, 1 << 20);
+    CHECK(arena.getStats().upstreamAllocations == 1);
+    CHECK(arena.getStats().retainedBytes == grown);
+
+    // A large page among small ones keeps the block
+    for (int i = 0; i < 15; ++i) {
+        allocatePage(arena, 1000);
+    }
+    CHECK(arena.getStats().retainedBytes == grown);
+
+    // Sixteen small pages in a row give it back
+    for (int i = 0; i < 16; ++i) {
+        allocatePage(arena, 1000);
+    }
+    CHECK(arena.getStats().retainedBytes == initial);
+    CHECK(arena.getStats().upstreamAllocations == 1);
+    CHECK(arena.getStats().releases == 33);
+}
+
+} // namespace
+
+int main() {
+    testGrowsAndShrinks();
+    return test::testResult();
+}
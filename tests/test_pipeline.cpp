@@ -0,0 +1,190 @@
+#include "check.hpp"
+#include "pipeline.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Items come out of a queue in the order they went in, a one-worker chain
+// keeps that order end to end, and a failing or throwing stage unwinds every
+// other stage instead of leaving it blocked on a queue.
+
+namespace {
+
+void testQueueOrderAndCapacity() {
+    BoundedQueue<int> queue(4);
+    std::thread producer([&] {
+        for (int i = 0; i < 1000; ++i) {
+            CHECK(queue.push(i));
+        }
+        queue.close();
+    });
+    std::vector<int> popped;
+    for (int item; queue.pop(item);) {
+        popped.push_back(item);
+    }
+    producer.join();
+
+    CHECK(popped.size() == 1000);
+    for (size_t i = 0; i < popped.size(); ++i) {
+        CHECK(popped[i] == static_cast<int>(i));
+    }
+    CHECK(queue.getStats().pushed == 1000);
+    CHECK(queue.getStats().highWater <= 4);
+    CHECK(!queue.push(1000));  // Closed
+}
+
+void testQueueCloseDrainsAbortDrops() {
+    BoundedQueue<int> closing(8);
+    closing.push(1);
+    closing.push(2);
+    closing.close();
+    int item = 0;
+    CHECK(closing.pop(item) && item == 1);
+    CHECK(closing.pop(item) && item == 2);
+    CHECK(!closing.pop(item));
+
+    BoundedQueue<int> aborting(8);
+    aborting.push(1);
+    aborting.abort();
+    CHECK(!aborting.pop(item));
+    CHECK(!aborting.push(2));
+}
+
+void testAbortWakesBlockedPush() {
+    BoundedQueue<int> queue(1);
+    queue.push(0);
+    std::atomic<bool> returned{false};
+    bool pushed = true;
+    std::thread producer([&] {
+        pushed = queue.push(1);  // Full: waits until aborted
+        returned = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!returned);
+    queue.abort();
+    producer.join();
+    CHECK(!pushed);
+}
+
+void testPipelineKeepsOrder() {
+    const int count = 500;
+    BoundedQueue<int> numbers(3), doubled(3);
+    std::vector<int> out;
+    Pipeline pipeline;
+    pipeline.addSource<int>("source", 1, numbers, [&](const std::function<bool(int)>& emit) {
+        for (int i = 0; i < count; ++i) {
+            if (!emit(i)) return false;
+        }
+        return true;
+    });
+    pipeline.addStage<int, int>("double", 1, numbers, doubled,
+        [](int& item, const std::function<bool(int)>& emit) { return emit(item * 2); });
+    pipeline.addSink<int>("sink", 1, doubled, [&](int& item) {
+        out.push_back(item);
+        return true;
+    });
+    CHECK(pipeline.run());
+
+    CHECK(out.size() == static_cast<size_t>(count));
+    for (size_t i = 0; i < out.size(); ++i) {
+        CHECK(out[i] == static_cast<int>(2 * i));
+    }
+    const auto& stats = pipeline.getStats();
+    CHECK(stats.size() == 3);
+    for (const auto& stage : stats) {
+        CHECK(stage.items == static_cast<size_t>(count));
+    }
+    CHECK(stats[0].queueCapacity == 3 && stats[0].queueHighWater <= 3);
+}
+
+void testParallelStageLosesNothing() {
+    const int count = 2000;
+    BoundedQueue<int> numbers(8);
+    BoundedQueue<long long> squares(8);
+    std::vector<long long> out;
+    std::atomic<int> next{0};
+    Pipeline pipeline;
+    pipeline.addSource<int>("source", 2, numbers, [&](const std::function<bool(int)>& emit) {
+        for (int i = next++; i < count; i = next++) {
+            if (!emit(i)) return false;
+        }
+        return true;
+    });
+    pipeline.addStage<int, long long>("square", 4, numbers, squares,
+        [](int& item, const std::function<bool(long long)>& emit) { return emit(1LL * item * item); });
+    pipeline.addSink<long long>("sink", 1, squares, [&](long long& item) {
+        out.push_back(item);
+        return true;
+    });
+    CHECK(pipeline.run());
+
+    std::sort(out.begin(), out.end());
+    CHECK(out.size() == static_cast<size_t>(count));
+    for (size_t i = 0; i < out.size(); ++i) {
+        CHECK(out[i] == static_cast<long long>(i * i));
+    }
+}
+
+// A middle stage fails (or throws) at item 50 of an endless source
+void runFailingPipeline(bool throwInstead) {
+    BoundedQueue<int> numbers(2), passed(2);
+    std::atomic<int> aborts{0};
+    bool sawFailedItem = false;
+    Pipeline pipeline;
+    pipeline.addSource<int>("source", 1, numbers, [](const std::function<bool(int)>& emit) {
+        for (int i = 0;; ++i) {
+            if (!emit(i)) return false;  // Only an abort ends this source
+        }
+    });
+    pipeline.addStage<int, int>("check", 2, numbers, passed,
+        [throwInstead](int& item, const std::function<bool(int)>& emit) {
+            if (item == 50) {
+                if (throwInstead) throw std::runtime_error("bad item");
+                return false;
+            }
+            return emit(item);
+        });
+    pipeline.addSink<int>("sink", 1, passed, [&](int& item) {
+        sawFailedItem |= item == 50;
+        return true;
+    });
+    pipeline.onAbort([&] { ++aborts; });
+
+    // Returning at all means the source, blocked on a full queue, was released
+    CHECK(!pipeline.run());
+    CHECK(aborts == 1);
+    CHECK(!sawFailedItem);
+}
+
+void testFailureUnwinds() {
+    runFailingPipeline(false);
+    runFailingPipeline(true);
+}
+
+void testAbortHandlerOnlyOnFailure() {
+    BoundedQueue<int> queue(2);
+    std::atomic<int> aborts{0};
+    Pipeline pipeline;
+    pipeline.addSource<int>("source", 1, queue, [](const std::function<bool(int)>& emit) {
+        return emit(1) && emit(2);
+    });
+    pipeline.addSink<int>("sink", 1, queue, [](int&) { return true; });
+    pipeline.onAbort([&] { ++aborts; });
+    CHECK(pipeline.run());
+    CHECK(aborts == 0);
+}
+
+} // namespace
+
+int main() {
+    testQueueOrderAndCapacity();
+    testQueueCloseDrainsAbortDrops();
+    testAbortWakesBlockedPush();
+    testPipelineKeepsOrder();
+    testParallelStageLosesNothing();
+    testFailureUnwinds();
+    testAbortHandlerOnlyOnFailure();
+    return test::testResult();
+}
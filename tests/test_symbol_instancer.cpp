@@ -0,0 +1,123 @@
+#include "check.hpp"
+#include "symbol_instancer.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// Each INSERT, expanded the way a CAD program draws it (scale, then rotate,
+// then move to the insertion point), gives back exactly the lines it
+// replaced, widths included.
+
+namespace {
+
+using Vector = PDFProcessor::VectorElement;
+using Segment = std::array<double, 4>;
+
+const double kPi = 3.14159265358979323846;
+
+// An asymmetric outline, so every placement has one pose that matches
+const std::vector<Segment> kShape = {
+    {0, 0, 4, 0}, {4, 0, 4, 1}, {4, 1, 1, 1}, {1, 1, 1, 3}, {1, 3, 0, 3}, {0, 3, 0, 0}, {1, 1, 2.5, 2}};
+
+struct Placement {
+    double x, y, scale, degrees;
+};
+
+void place(std::vector<Vector>& vectors, const Placement& p, double width) {
+    const double c = std::cos(p.degrees * kPi / 180.0), s = std::sin(p.degrees * kPi / 180.0);
+    for (const Segment& seg : kShape) {
+        Vector v{Vector::Type::LINE, {}, width, 0};
+        for (int k = 0; k < 4; k += 2) {
+            const double x = seg[k] * p.scale, y = seg[k + 1] * p.scale;
+            v.points[k] = p.x + c * x - s * y;
+            v.points[k + 1] = p.y + s * x + c * y;
+        }
+        vectors.push_back(v);
+    }
+}
+
+bool sameSegment(const Segment& a, const Segment& b, double tolerance) {
+    auto near = [tolerance](double u, double v) { return std::abs(u - v) <= tolerance; };
+    const bool forward = near(a[0], b[0]) && near(a[1], b[1]) && near(a[2], b[2]) && near(a[3], b[3]);
+    const bool backward = near(a[0], b[2]) && near(a[1], b[3]) && near(a[2], b[0]) && near(a[3], b[1]);
+    return forward || backward;
+}
+
+void testInsertsReproduceTheirLines() {
+    const std::vector<Placement> placements = {
+        {10, 10, 1.0, 0}, {50, 10, 1.0, 90}, {90, 40, 2.0, 30}, {20, 80, 0.5, -135}, {120, 120, 1.5, 200}};
+    std::vector<Vector> vectors;
+    for (const Placement& p : placements) {
+        place(vectors, p, 0.35);
+    }
+    // The same shape drawn thinner is a different block
+    place(vectors, {200, 10, 1.0, 0}, 0.18);
+    place(vectors, {200, 60, 1.0, 45}, 0.18);
+    // A stray line, which stays a line
+    vectors.push_back({Vector::Type::LINE, {300, 300, 310, 305}, 0.25, 0});
+
+    SymbolInstancer::Options options;
+    options.joinTolerance = 0.01;
+    const SymbolInstancer::Result result = SymbolInstancer(options).detect(vectors);
+
+    CHECK(result.blocks.size() == 2);
+    CHECK(result.inserts.size() == placements.size() + 2);
+    CHECK(result.instanced.size() == vectors.size());
+    CHECK(result.instancedSegments == vectors.size() - 1);
+    CHECK(!result.instanced.back());
+
+    // Expand every INSERT and match its segments to the instanced input lines
+    std::vector<bool> matched(vectors.size(), false);
+    for (const SymbolInstancer::Insert& insert : result.inserts) {
+        CHECK(insert.block < result.blocks.size());
+        if (insert.block >= result.blocks.size()) continue;
+        const SymbolInstancer::Block& block = result.blocks[insert.block];
+        CHECK(block.segments.size() == 4 * kShape.size());
+        CHECK(block.widths.size() == kShape.size());
+
+        const double c = std::cos(insert.rotation * kPi / 180.0), s = std::sin(insert.rotation * kPi / 180.0);
+        for (size_t i = 0; i + 3 < block.segments.size(); i += 4) {
+            Segment expanded;
+            for (int k = 0; k < 4; k += 2) {
+                const double x = block.segments[i + k] * insert.scale, y = block.segments[i + k + 1] * insert.scale;
+                expanded[k] = insert.x + c * x - s * y;
+                expanded[k + 1] = insert.y + s * x + c * y;
+            }
+            bool found = false;
+            for (size_t v = 0; v < vectors.size() && !found; ++v) {
+                if (!matched[v] && result.instanced[v] && sameSegment(expanded, vectors[v].points, 1e-3) &&
+                    std::abs(block.widths[i / 4] - vectors[v].thickness) < 1e-9) {
+                    matched[v] = found = true;
+                }
+            }
+            CHECK(found);
+        }
+    }
+    CHECK(std::count(matched.begin(), matched.end(), true) == static_cast<long>(result.instancedSegments));
+}
+
+void testMirroredCopiesStayLines() {
+    std::vector<Vector> vectors;
+    place(vectors, {0, 0, 1.0, 0}, 0.0);
+    // The same outline reflected in the Y axis
+    const size_t first = vectors.size();
+    place(vectors, {50, 0, 1.0, 0}, 0.0);
+    for (size_t v = first; v < vectors.size(); ++v) {
+        vectors[v].points[0] = 100 - vectors[v].points[0];
+        vectors[v].points[2] = 100 - vectors[v].points[2];
+    }
+
+    const SymbolInstancer::Result result = SymbolInstancer().detect(vectors);
+    CHECK(result.blocks.empty());
+    CHECK(result.inserts.empty());
+    CHECK(result.instancedSegments == 0);
+}
+
+} // namespace
+
+int main() {
+    testInsertsReproduceTheirLines();
+    testMirroredCopiesStayLines();
+    return test::testResult();
+}
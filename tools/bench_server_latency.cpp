@@ -0,0 +1,126 @@
+#include "conversion_client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures end-to-end request latency against a running `pdf2cad --serve`
+// instance and, optionally, against one pdf2cad process per conversion.
+static void printUsage() {
+    fprintf(stderr,
+        "Usage: bench_server_latency <socket-path> <input.pdf> [options]\n"
+        "Options:\n"
+        "  --requests <n>     Conversions to time (default 50)\n"
+        "  --concurrency <n>  Parallel clients (default 1)\n"
+        "  --cli <pdf2cad>    Also time one process per conversion\n");
+}
+
+static void report(const char* label, std::vector<double> millis) {
+    if (millis.empty()) {
+        printf("%-8s no successful requests\n", label);
+        return;
+    }
+    std::sort(millis.begin(), millis.end());
+    double total = 0.0;
+    for (double ms : millis) {
+        total += ms;
+    }
+    auto percentile = [&millis](double p) {
+        size_t index = static_cast<size_t>(p * (millis.size() - 1) + 0.5);
+        return millis[index];
+    };
+    printf("%-8s n=%zu  min=%.1f  p50=%.1f  p95=%.1f  max=%.1f  mean=%.1f ms\n",
+        label, millis.size(), millis.front(), percentile(0.50), percentile(0.95),
+        millis.back(), total / millis.size());
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+
+    std::string socketPath = argv[1];
+    std::string inputPath = argv[2];
+    int requests = 50;
+    int concurrency = 1;
+    std::string cliPath;
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            requests = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc) {
+            concurrency = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--cli") == 0 && i + 1 < argc) {
+            cliPath = argv[++i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // Server: upload the PDF and receive the DXF, as an interactive client would
+    std::vector<double> serverMillis;
+    std::mutex resultsMutex;
+    std::atomic<int> remaining{requests};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> clients;
+    auto wallStart = std::chrono::steady_clock::now();
+    for (int c = 0; c < concurrency; ++c) {
+        clients.emplace_back([&] {
+            ConversionRequest request;
+            request.inputPath = inputPath;
+            request.uploadInput = true;
+            while (remaining-- > 0) {
+                ConversionReply reply;
+                auto start = std::chrono::steady_clock::now();
+                bool ok = requestConversion(socketPath, request, reply);
+                double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                if (!ok) {
+                    ++failures;
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(resultsMutex);
+                serverMillis.push_back(ms);
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    double wallSeconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wallStart).count();
+
+    report("server", serverMillis);
+    printf("         %.1f conversions/s, %d failed\n",
+        serverMillis.size() / wallSeconds, failures.load());
+
+    // Cold process per conversion, the pre-server baseline
+    if (!cliPath.empty()) {
+        std::vector<double> cliMillis;
+        std::string command = "\"" + cliPath + "\" \"" + inputPath + "\" bench_server_latency_cli.dxf";
+#ifdef _WIN32
+        command += " > NUL 2>&1";
+#else
+        command += " > /dev/null 2>&1";
+#endif
+        for (int i = 0; i < requests; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            int status = std::system(command.c_str());
+            double ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            if (status == 0) {
+                cliMillis.push_back(ms);
+            }
+        }
+        std::remove("bench_server_latency_cli.dxf");
+        report("process", cliMillis);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include "raster_vectorizer.hpp"
+#include "poppler-document.h"
+#include "poppler-page.h"
+#include "poppler-page-renderer.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compares the raster vectorization backends on the pages of one PDF:
+// time per page and the number of LINE entities each would produce.
+
+static void printUsage() {
+    fprintf(stderr,
+        "Usage: bench_vectorizers <input.pdf> [options]\n"
+        "Options:\n"
+        "  --render-scale <n>  Render resolution as a multiple of 72 DPI (default 4)\n"
+        "  --threads <n>       Threads per page for segments and centerline (default: all)\n"
+        "  --repeat <n>        Runs per page and backend; the fastest is reported (default 3)\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::string inputPath = argv[1];
+    double scale = 4.0;
+    int repeat = 3;
+    RasterVectorizer::Options options;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::unique_ptr<poppler::document> doc(poppler::document::load_from_file(inputPath));
+    if (!doc) {
+        fprintf(stderr, "Failed to load %s\n", inputPath.c_str());
+        return 1;
+    }
+
+    poppler::page_renderer renderer;
+    renderer.set_render_hints(
+        poppler::page_renderer::antialiasing |
+        poppler::page_renderer::text_antialiasing |
+        poppler::page_renderer::text_hinting
+    );
+
+    const RasterVectorizer::Backend backends[] = {
+        RasterVectorizer::Backend::Contours,
+        RasterVectorizer::Backend::Segments,
+        RasterVectorizer::Backend::Centerline
+    };
+    const int backendCount = sizeof(backends) / sizeof(backends[0]);
+    double totalMillis[backendCount] = {};
+    size_t totalSegments[backendCount] = {};
+
+    for (int i = 0; i < doc->pages(); ++i) {
+        std::unique_ptr<poppler::page> page(doc->create_page(i));
+        if (!page) {
+            continue;
+        }
+        poppler::image img = renderer.render_page(page.get(), 72.0 * scale, 72.0 * scale);
+        if (!img.is_valid()) {
+            continue;
+        }
+        cv::Mat image(img.height(), img.width(), CV_8UC4, const_cast<char*>(img.const_data()));
+        cv::Mat gray;
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+        printf("page %d (%dx%d px)\n", i + 1, gray.cols, gray.rows);
+
+        for (int b = 0; b < backendCount; ++b) {
+            std::unique_ptr<RasterVectorizer> vectorizer = RasterVectorizer::create(backends[b], options);
+            RasterPaths paths;
+            double best = 0.0;
+            for (int r = 0; r < repeat; ++r) {
+                paths.clear();
+                auto start = std::chrono::steady_clock::now();
+                vectorizer->vectorize(gray, paths);
+                double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+                best = r == 0 ? ms : std::min(best, ms);
+            }
+            size_t segments = paths.segmentCount();
+            printf("  %-10s %9.1f ms  %8zu paths  %9zu line entities\n",
+                RasterVectorizer::backendName(backends[b]), best, paths.pathCount(), segments);
+            totalMillis[b] += best;
+            totalSegments[b] += segments;
+        }
+    }
+
+    printf("total\n");
+    for (int b = 0; b < backendCount; ++b) {
+        printf("  %-10s %9.1f ms  %9zu line entities\n",
+            RasterVectorizer::backendName(backends[b]), totalMillis[b], totalSegments[b]);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "conversion_client.hpp"
+#include "output_sink.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Submits one conversion to a running `pdf2cad --serve` instance
+static void printUsage() {
+    fprintf(stderr,
+        "Usage: pdf2cad_client <socket-path> <input.pdf> <output.dxf> [options]\n"
+        "Options:\n"
+        "  --upload               Send the PDF contents and receive the DXF back\n"
+        "                         instead of letting the server access the paths;\n"
+        "                         needed unless the server runs with --path-root,\n"
+        "                         which relative paths are then taken from\n"
+        "  --render-scale <n>     Render resolution as a multiple of 72 DPI\n"
+        "  --quantization-grid <mm>\n"
+        "  --page-gap <mm>\n"
+        "  --vectorizer <name>    contours (default), segments or centerline\n"
+        "  --page-seconds <s>     Per-page budgets; pages over them are simplified,\n"
+        "  --page-max-paths <n>   traced at lower resolution or embedded as an image\n"
+        "  --page-max-entities <n> (left empty instead when the DXF is sent back)\n"
+        "  --compression <codec>  none, gzip or zstd; the default follows the\n"
+        "                         output name (.dxf.gz, .dxf.zst)\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        printUsage();
+        return 1;
+    }
+
+    std::string socketPath = argv[1];
+    ConversionRequest request;
+    request.inputPath = argv[2];
+    std::string outputPath = argv[3];
+
+    for (int i = 4; i < argc; ++i) {
+        if (strcmp(argv[i], "--upload") == 0) {
+            request.uploadInput = true;
+        } else if (strncmp(argv[i], "--", 2) == 0 && i + 1 < argc) {
+            request.options.emplace_back(argv[i] + 2, argv[i + 1]);
+            ++i;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            printUsage();
+            return 1;
+        }
+    }
+    if (!request.uploadInput) {
+        request.outputPath = outputPath;
+    } else if (std::none_of(request.options.begin(), request.options.end(),
+                            [](const auto& option) { return option.first == "compression"; })) {
+        // Returned data has no file name for the server to go by
+        request.options.emplace_back("compression",
+            OutputSink::compressionName(OutputSink::compressionForPath(outputPath)));
+    }
+
+    ConversionReply reply;
+    bool ok = requestConversion(socketPath, request, reply, [](const std::string& status) {
+        fprintf(stderr, "%s\n", status.c_str());
+    });
+    if (!ok) {
+        fprintf(stderr, "Conversion failed: %s\n", reply.error.c_str());
+        return 1;
+    }
+
+    if (request.uploadInput) {
+        std::ofstream file(outputPath, std::ios::binary);
+        if (!file.write(reply.output.data(), reply.output.size())) {
+            fprintf(stderr, "Failed to write %s\n", outputPath.c_str());
+            return 1;
+        }
+    }
+    fprintf(stderr, "Wrote %s\n", outputPath.c_str());
+    return 0;
+}